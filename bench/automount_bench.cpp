@@ -0,0 +1,219 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// End-to-end automount benchmark.
+///
+/// Runs UDISKEN's object manager against the fake UDisks and notification
+/// services on the session bus, which should be a private one (see
+/// dbus-run-session(1)), then plugs in a storm of block devices and reports:
+/// - time until the object manager is ready, having scanned existing devices;
+/// - latency between a device being announced and UDISKEN mounting it;
+/// - peak resident memory.
+
+#include "loop.hpp"
+#include "mount.hpp"
+#include "notify.hpp"
+#include "udisks.hpp"
+
+#include <argparse/argparse.hpp>
+#include <sdbus-c++/sdbus-c++.h>
+#include <spawn.h>
+#include <spdlog/spdlog.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const sdbus::ServiceName kFakeServiceName{"org.freedesktop.UDisks2"};
+const sdbus::ObjectPath kControlObjectPath{"/org/udisken/Fake"};
+constexpr auto kControlInterfaceName{"org.udisken.Fake"};
+
+constexpr std::chrono::milliseconds kPollInterval{5};
+constexpr std::chrono::seconds kTimeout{60};
+
+/// Fake services process, terminated when going out of scope.
+class FakeServicesProcess {
+ public:
+  FakeServicesProcess(const std::string& path, std::uint32_t initial_devices) {
+    std::string initial{std::to_string(initial_devices)};
+    std::string initial_flag{"--initial"};
+    std::string program{path};
+    std::vector<char*> argv{program.data(), initial_flag.data(),
+                            initial.data(), nullptr};
+    if (const int err{
+            posix_spawn(&pid_, path.c_str(), nullptr, nullptr, argv.data(),
+                        environ)};
+        err != 0) {
+      throw std::system_error{err, std::generic_category(),
+                              "could not start fake services"};
+    }
+  }
+
+  FakeServicesProcess(const FakeServicesProcess&) = delete;
+  FakeServicesProcess(FakeServicesProcess&&) = delete;
+  FakeServicesProcess& operator=(const FakeServicesProcess&) = delete;
+  FakeServicesProcess& operator=(FakeServicesProcess&&) = delete;
+
+  ~FakeServicesProcess() noexcept {
+    kill(pid_, SIGTERM);
+    waitpid(pid_, nullptr, 0);
+  }
+
+ private:
+  pid_t pid_{};
+};
+
+/// Wait until the fake services own their bus name.
+///
+/// @return The name got owned before timing out.
+bool WaitForFakeServices(sdbus::IConnection& connection) {
+  const auto dbus{sdbus::createProxy(
+      connection, sdbus::ServiceName{"org.freedesktop.DBus"},
+      sdbus::ObjectPath{"/org/freedesktop/DBus"})};
+
+  for (const auto deadline{Clock::now() + kTimeout}; Clock::now() < deadline;
+       std::this_thread::sleep_for(kPollInterval)) {
+    bool has_owner{};
+    dbus->callMethod("NameHasOwner")
+        .onInterface("org.freedesktop.DBus")
+        .withArguments(std::string{kFakeServiceName})
+        .storeResultsTo(has_owner);
+    if (has_owner) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/// Nearest-rank percentile of sorted values.
+std::uint64_t Percentile(const std::vector<std::uint64_t>& sorted,
+                         std::size_t percent) {
+  const std::size_t rank{(percent * sorted.size() + 99) / 100};
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  argparse::ArgumentParser program{"automount-bench"};
+  program.add_argument("fake_services").help("path to the fake-udisks program");
+  program.add_argument("--initial")
+      .help("number of block devices present before UDISKEN starts")
+      .default_value(std::uint32_t{100})
+      .scan<'u', std::uint32_t>();
+  program.add_argument("--devices")
+      .help("number of block devices plugged in at once")
+      .default_value(std::uint32_t{100})
+      .scan<'u', std::uint32_t>();
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::exception& e) {
+    spdlog::critical("{}", e.what());
+    std::cerr << program;
+    return EXIT_FAILURE;
+  }
+  const auto devices{program.get<std::uint32_t>("--devices")};
+
+  // Measure UDISKEN, not its logging to the terminal.
+  spdlog::set_level(spdlog::level::warn);
+
+  const FakeServicesProcess fake_services{
+      program.get<std::string>("fake_services"),
+      program.get<std::uint32_t>("--initial")};
+
+  const auto control_connection{sdbus::createSessionBusConnection()};
+  if (!WaitForFakeServices(*control_connection)) {
+    spdlog::critical("Fake services did not start");
+    return EXIT_FAILURE;
+  }
+  const auto control{sdbus::createProxy(
+      *control_connection, kFakeServiceName, kControlObjectPath)};
+
+  // The private session bus plays the part of the system bus too.
+  const auto connection{sdbus::createSessionBusConnection()};
+  notify::Client notify_client{};
+  // Without a loop nor window: every mount is notified right away, as the
+  // worst case for the notification server.
+  mount::Notifier notifier{notify_client, nullptr, nullptr, nullptr,
+                           nullptr};
+
+  const auto start{Clock::now()};
+  managers::UdisksObjectManager obj_mgr{
+      *connection, mount::Context{.notifier = &notifier}};
+  const auto ready{Clock::now()};
+
+  loop::MainLoop main_loop{};
+  main_loop.AddConnection(*connection);
+  std::thread loop_thread{[&main_loop] { main_loop.Run(); }};
+
+  control->callMethod("AddDevices")
+      .onInterface(kControlInterfaceName)
+      .withArguments(devices);
+
+  std::vector<std::uint64_t> latencies{};
+  for (const auto deadline{Clock::now() + kTimeout};
+       latencies.size() < devices && Clock::now() < deadline;
+       std::this_thread::sleep_for(kPollInterval)) {
+    control->callMethod("GetLatencies")
+        .onInterface(kControlInterfaceName)
+        .storeResultsTo(latencies);
+  }
+  main_loop.Quit();
+  loop_thread.join();
+
+  if (latencies.size() < devices) {
+    spdlog::critical("Only {} of {} devices got mounted", latencies.size(),
+                     devices);
+    return EXIT_FAILURE;
+  }
+
+  std::ranges::sort(latencies);
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+
+  std::cout << std::format(
+      "time to ready: {} us\n"
+      "signal to mount ({} devices): p50 {} us, p90 {} us, p99 {} us, "
+      "max {} us\n"
+      "peak RSS: {} KiB\n",
+      std::chrono::duration_cast<std::chrono::microseconds>(ready - start)
+          .count(),
+      latencies.size(), Percentile(latencies, 50), Percentile(latencies, 90),
+      Percentile(latencies, 99), latencies.back(), usage.ru_maxrss);
+
+  return EXIT_SUCCESS;
+}
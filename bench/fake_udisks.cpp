@@ -0,0 +1,255 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Fake UDisks and notification services, to benchmark UDISKEN on a private
+/// bus without any real drive.
+///
+/// Exposes block devices with a filesystem through the UDisks object manager,
+/// answers Filesystem.Mount immediately, and records the time between
+/// announcing a block device and UDISKEN asking to mount it.
+
+#include <argparse/argparse.hpp>
+#include <sdbus-c++/sdbus-c++.h>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <format>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr auto kUdisksServiceName{"org.freedesktop.UDisks2"};
+constexpr auto kUdisksObjectPath{"/org/freedesktop/UDisks2"};
+constexpr auto kBlockInterfaceName{"org.freedesktop.UDisks2.Block"};
+constexpr auto kFilesystemInterfaceName{"org.freedesktop.UDisks2.Filesystem"};
+
+constexpr auto kNotifServiceName{"org.freedesktop.Notifications"};
+constexpr auto kNotifObjectPath{"/org/freedesktop/Notifications"};
+
+constexpr auto kControlObjectPath{"/org/udisken/Fake"};
+constexpr auto kControlInterfaceName{"org.udisken.Fake"};
+
+using Clock = std::chrono::steady_clock;
+using MountPoints = std::vector<std::vector<std::uint8_t>>;
+using MountOptions = std::map<std::string, sdbus::Variant>;
+
+/// Fake block device object, implementing the Block and Filesystem
+/// interfaces.
+class FakeBlockDevice {
+ public:
+  /// @param latencies Where to record the time between announcing this device
+  /// and UDISKEN mounting it, in microseconds.
+  FakeBlockDevice(sdbus::IConnection& connection, std::uint32_t index,
+                  std::vector<std::uint64_t>& latencies)
+      : name_{std::format("bench{}", index)},
+        object_{sdbus::createObject(
+            connection,
+            sdbus::ObjectPath{std::format(
+                "{}/block_devices/{}", kUdisksObjectPath, name_)})},
+        latencies_{&latencies} {
+    object_
+        ->addVTable(
+            sdbus::registerProperty("Drive").withGetter(
+                [] { return sdbus::ObjectPath{"/"}; }),
+            sdbus::registerProperty("HintAuto").withGetter([] { return true; }),
+            sdbus::registerProperty("HintIgnore").withGetter([] {
+              return false;
+            }),
+            sdbus::registerProperty("HintSystem").withGetter([] {
+              return false;
+            }),
+            sdbus::registerProperty("HintName").withGetter([] {
+              return std::string{};
+            }),
+            sdbus::registerProperty("HintIconName").withGetter([] {
+              return std::string{};
+            }),
+            sdbus::registerProperty("IdLabel").withGetter(
+                [this] { return name_; }),
+            sdbus::registerProperty("IdType").withGetter([] {
+              return std::string{"vfat"};
+            }),
+            sdbus::registerProperty("IdUsage").withGetter([] {
+              return std::string{"filesystem"};
+            }),
+            sdbus::registerProperty("ReadOnly").withGetter([] {
+              return false;
+            }))
+        .forInterface(sdbus::InterfaceName{kBlockInterfaceName});
+    object_
+        ->addVTable(
+            sdbus::registerMethod("Mount")
+                .withInputParamNames("options")
+                .withOutputParamNames("mount_path")
+                .implementedAs([this](const MountOptions& options) {
+                  return Mount(options);
+                }),
+            sdbus::registerProperty("MountPoints").withGetter([this] {
+              return mount_points_;
+            }))
+        .forInterface(sdbus::InterfaceName{kFilesystemInterfaceName});
+  }
+
+  /// Announce this block device, as if it was just plugged in.
+  void EmitAdded() {
+    added_ = Clock::now();
+    object_->emitInterfacesAddedSignal();
+  }
+
+ private:
+  std::string Mount([[maybe_unused]] const MountOptions& options) {
+    if (added_) {
+      latencies_->push_back(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                                *added_)
+              .count()));
+    }
+
+    if (!mount_points_.empty()) {
+      throw sdbus::Error{
+          sdbus::Error::Name{"org.freedesktop.UDisks2.Error.AlreadyMounted"},
+          "Device is already mounted"};
+    }
+
+    auto mnt_point{std::format("/run/media/bench/{}", name_)};
+    std::vector<std::uint8_t> mnt_point_bytes{mnt_point.begin(),
+                                              mnt_point.end()};
+    mnt_point_bytes.push_back(0);
+    mount_points_.push_back(std::move(mnt_point_bytes));
+    object_->emitPropertiesChangedSignal(
+        sdbus::InterfaceName{kFilesystemInterfaceName},
+        {sdbus::PropertyName{"MountPoints"}});
+
+    return mnt_point;
+  }
+
+  std::string name_;
+  std::unique_ptr<sdbus::IObject> object_;
+  std::vector<std::uint64_t>* latencies_;
+  MountPoints mount_points_{};
+  /// When this device was announced; nothing if it existed from the start.
+  std::optional<Clock::time_point> added_{};
+};
+
+/// Fake UDisks object manager, notification server, and the control interface
+/// used by benchmarks to plug in devices.
+class FakeServices {
+ public:
+  FakeServices(sdbus::IConnection& connection, std::uint32_t initial_devices)
+      : connection_{&connection},
+        manager_{sdbus::createObject(connection,
+                                     sdbus::ObjectPath{kUdisksObjectPath})},
+        notifications_{sdbus::createObject(
+            connection, sdbus::ObjectPath{kNotifObjectPath})},
+        control_{sdbus::createObject(connection,
+                                     sdbus::ObjectPath{kControlObjectPath})} {
+    manager_->addObjectManager();
+
+    notifications_
+        ->addVTable(
+            sdbus::registerMethod("GetCapabilities").implementedAs([] {
+              return std::vector<std::string>{"actions", "body"};
+            }),
+            sdbus::registerMethod("Notify").implementedAs(
+                [this](const std::string&, std::uint32_t replaces_id,
+                       const std::string&, const std::string&,
+                       const std::string&, const std::vector<std::string>&,
+                       const MountOptions&, std::int32_t) {
+                  return replaces_id != 0 ? replaces_id
+                                          : ++last_notification_id_;
+                }),
+            sdbus::registerMethod("CloseNotification")
+                .implementedAs([](std::uint32_t) {}),
+            sdbus::registerSignal("ActionInvoked")
+                .withParameters<std::uint32_t, std::string>(),
+            sdbus::registerSignal("NotificationClosed")
+                .withParameters<std::uint32_t, std::uint32_t>())
+        .forInterface(sdbus::InterfaceName{kNotifServiceName});
+
+    control_
+        ->addVTable(
+            sdbus::registerMethod("AddDevices")
+                .withInputParamNames("count")
+                .implementedAs(
+                    [this](std::uint32_t count) { AddDevices(count, true); }),
+            sdbus::registerMethod("GetLatencies")
+                .withOutputParamNames("latencies_us")
+                .implementedAs([this] { return latencies_; }))
+        .forInterface(sdbus::InterfaceName{kControlInterfaceName});
+
+    AddDevices(initial_devices, false);
+  }
+
+ private:
+  /// @param announce Emit InterfacesAdded for the new devices, as if they were
+  /// plugged in.
+  void AddDevices(std::uint32_t count, bool announce) {
+    for (std::uint32_t i{0}; i < count; ++i) {
+      const auto index{static_cast<std::uint32_t>(devices_.size())};
+      auto& device{devices_.emplace_back(std::make_unique<FakeBlockDevice>(
+          *connection_, index, latencies_))};
+      if (announce) {
+        device->EmitAdded();
+      }
+    }
+  }
+
+  sdbus::IConnection* connection_;
+  std::unique_ptr<sdbus::IObject> manager_;
+  std::unique_ptr<sdbus::IObject> notifications_;
+  std::unique_ptr<sdbus::IObject> control_;
+  std::vector<std::unique_ptr<FakeBlockDevice>> devices_{};
+  std::vector<std::uint64_t> latencies_{};
+  std::uint32_t last_notification_id_{0};
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  argparse::ArgumentParser program{"fake-udisks"};
+  program.add_argument("--initial")
+      .help("number of block devices present from the start")
+      .default_value(std::uint32_t{0})
+      .scan<'u', std::uint32_t>();
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::exception& e) {
+    spdlog::critical("{}", e.what());
+    std::cerr << program;
+    return EXIT_FAILURE;
+  }
+
+  const auto connection{sdbus::createSessionBusConnection()};
+  FakeServices services{*connection, program.get<std::uint32_t>("--initial")};
+
+  // Benchmarks wait for the UDisks name: request it last.
+  connection->requestName(sdbus::ServiceName{kNotifServiceName});
+  connection->requestName(sdbus::ServiceName{kUdisksServiceName});
+
+  connection->enterEventLoop();
+}
@@ -0,0 +1,442 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Microbenchmarks of the CPU-bound code run for each UDisks event: decoding
+/// mount points, into copies or views, reading options, looking up interfaces,
+/// caching the properties of announced block devices and rejecting them early,
+/// and building mount notifications.
+///
+/// Payloads are those of a server with hundreds of block devices, as listed by
+/// GetManagedObjects: made up after such a listing, or read from a recording
+/// made by `udisken --record` if the UDISKEN_BENCH_RECORDING environment
+/// variable names one. Each benchmark reports its heap allocations per
+/// iteration next to its timings, so that allocation regressions show up.
+
+#include "arena.hpp"
+#include "mount.hpp"
+#include "options.hpp"
+#include "policy.hpp"
+#include "record.hpp"
+#include "udisks.hpp"
+
+#include <benchmark/benchmark.h>
+#include <sdbus-c++/Types.h>
+#include <udisks-sdbus-cpp/udisks_proxy_wrappers.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// Heap allocations made by the process, counted by operator new.
+std::atomic<std::uint64_t> allocations{0};
+
+}  // namespace
+
+// Not inlined, lest GCC pair the inlined malloc and free with the new and
+// delete expressions of the benchmarks, and warn about mismatches.
+[[gnu::noinline]] void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* const ptr{std::malloc(size == 0 ? 1 : size)}; ptr != nullptr) {
+    return ptr;
+  }
+
+  throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+[[gnu::noinline]] void operator delete(
+    void* ptr, [[maybe_unused]] std::size_t size) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+using RawMountPoints = std::vector<std::vector<std::uint8_t>>;
+using Object = std::pair<sdbus::ObjectPath, objects::InterfaceMap>;
+
+/// Disks of the made-up server, each with a partition table and
+/// kPartitions partitions.
+constexpr std::size_t kDisks{100};
+constexpr std::size_t kPartitions{3};
+
+constexpr auto kBlockInterfaceName{"org.freedesktop.UDisks2.Block"};
+constexpr auto kPartitionInterfaceName{"org.freedesktop.UDisks2.Partition"};
+constexpr auto kPartitionTableInterfaceName{
+    "org.freedesktop.UDisks2.PartitionTable"};
+constexpr auto kFilesystemInterfaceName{"org.freedesktop.UDisks2.Filesystem"};
+
+/// Reports the heap allocations made per iteration, from the counter's value
+/// before the benchmark loop.
+class AllocationCounter {
+ public:
+  explicit AllocationCounter(benchmark::State& state) : state_{&state} {}
+
+  AllocationCounter(const AllocationCounter&) = delete;
+  AllocationCounter(AllocationCounter&&) = delete;
+  AllocationCounter& operator=(const AllocationCounter&) = delete;
+  AllocationCounter& operator=(AllocationCounter&&) = delete;
+
+  ~AllocationCounter() noexcept {
+    state_->counters["allocs"] = benchmark::Counter{
+        static_cast<double>(allocations.load(std::memory_order_relaxed) -
+                            start_),
+        benchmark::Counter::kAvgIterations};
+  }
+
+ private:
+  benchmark::State* state_;
+  std::uint64_t start_{allocations.load(std::memory_order_relaxed)};
+};
+
+std::vector<std::uint8_t> Bytes(std::string_view str) {
+  std::vector<std::uint8_t> bytes{str.begin(), str.end()};
+  bytes.push_back(0);
+
+  return bytes;
+}
+
+/// Block interface properties of a made-up device, as UDisks sends them.
+objects::PropertyMap BlockProperties(const std::string& name,
+                                     const std::string& drive,
+                                     std::uint64_t size, bool filesystem) {
+  return {
+      {sdbus::PropertyName{"Device"}, sdbus::Variant{Bytes("/dev/" + name)}},
+      {sdbus::PropertyName{"PreferredDevice"},
+       sdbus::Variant{Bytes("/dev/" + name)}},
+      {sdbus::PropertyName{"Symlinks"},
+       sdbus::Variant{RawMountPoints{
+           Bytes(std::format("/dev/disk/by-id/wwn-0x5000c500{}", name)),
+           Bytes(std::format("/dev/disk/by-path/pci-0000:00:17.0-ata-{}",
+                             name))}}},
+      {sdbus::PropertyName{"DeviceNumber"},
+       sdbus::Variant{std::uint64_t{2048}}},
+      {sdbus::PropertyName{"Id"},
+       sdbus::Variant{std::format("by-id-wwn-0x5000c500{}", name)}},
+      {sdbus::PropertyName{"Size"}, sdbus::Variant{size}},
+      {sdbus::PropertyName{"ReadOnly"}, sdbus::Variant{false}},
+      {sdbus::PropertyName{"Drive"}, sdbus::Variant{sdbus::ObjectPath{drive}}},
+      {sdbus::PropertyName{"MDRaid"}, sdbus::Variant{sdbus::ObjectPath{"/"}}},
+      {sdbus::PropertyName{"MDRaidMember"},
+       sdbus::Variant{sdbus::ObjectPath{"/"}}},
+      {sdbus::PropertyName{"IdUsage"},
+       sdbus::Variant{std::string{filesystem ? "filesystem" : ""}}},
+      {sdbus::PropertyName{"IdType"},
+       sdbus::Variant{std::string{filesystem ? "ext4" : ""}}},
+      {sdbus::PropertyName{"IdVersion"},
+       sdbus::Variant{std::string{filesystem ? "1.0" : ""}}},
+      {sdbus::PropertyName{"IdLabel"}, sdbus::Variant{name}},
+      {sdbus::PropertyName{"IdUUID"},
+       sdbus::Variant{std::format("3f1c9a2e-4d61-b7e0-{:0>12}", name)}},
+      {sdbus::PropertyName{"CryptoBackingDevice"},
+       sdbus::Variant{sdbus::ObjectPath{"/"}}},
+      {sdbus::PropertyName{"HintPartitionable"}, sdbus::Variant{true}},
+      {sdbus::PropertyName{"HintSystem"}, sdbus::Variant{true}},
+      {sdbus::PropertyName{"HintIgnore"}, sdbus::Variant{false}},
+      {sdbus::PropertyName{"HintAuto"}, sdbus::Variant{false}},
+      {sdbus::PropertyName{"HintName"}, sdbus::Variant{std::string{}}},
+      {sdbus::PropertyName{"HintIconName"}, sdbus::Variant{std::string{}}},
+      {sdbus::PropertyName{"HintSymbolicIconName"},
+       sdbus::Variant{std::string{}}},
+      {sdbus::PropertyName{"UserspaceMountOptions"},
+       sdbus::Variant{std::vector<std::string>{}}},
+  };
+}
+
+/// Objects of a made-up server with hundreds of block devices: disks with a
+/// partition table, whose partitions have a filesystem, mounted in one or two
+/// places, or not at all.
+std::vector<Object> MadeUpObjects() {
+  std::vector<Object> objects{};
+  for (std::size_t disk{0}; disk < kDisks; ++disk) {
+    const auto name{std::format("sd{}{}", static_cast<char>('a' + disk / 26),
+                                static_cast<char>('a' + disk % 26))};
+    const auto drive{std::format(
+        "/org/freedesktop/UDisks2/drives/ST4000NM000A_2HC015_WS2{:0>5}", disk)};
+    const std::uint64_t disk_size{4'000'787'030'016};
+
+    objects::InterfaceMap disk_interfaces{
+        {sdbus::InterfaceName{kBlockInterfaceName},
+         BlockProperties(name, drive, disk_size, false)},
+        {sdbus::InterfaceName{kPartitionTableInterfaceName},
+         {{sdbus::PropertyName{"Type"}, sdbus::Variant{std::string{"gpt"}}}}}};
+    objects.emplace_back(
+        sdbus::ObjectPath{
+            std::format("/org/freedesktop/UDisks2/block_devices/{}", name)},
+        std::move(disk_interfaces));
+
+    for (std::size_t partition{1}; partition <= kPartitions; ++partition) {
+      const auto part_name{std::format("{}{}", name, partition)};
+      RawMountPoints mount_points{};
+      for (std::size_t i{0}; i < partition - 1; ++i) {
+        mount_points.push_back(
+            Bytes(std::format("/srv/{}/{}", i == 0 ? "data" : "bind",
+                              part_name)));
+      }
+
+      objects::InterfaceMap interfaces{
+          {sdbus::InterfaceName{kBlockInterfaceName},
+           BlockProperties(part_name, drive, disk_size / kPartitions, true)},
+          {sdbus::InterfaceName{kPartitionInterfaceName},
+           {{sdbus::PropertyName{"Number"},
+             sdbus::Variant{static_cast<std::uint32_t>(partition)}},
+            {sdbus::PropertyName{"Type"},
+             sdbus::Variant{
+                 std::string{"0fc63daf-8483-4772-8e79-3d69d8477de4"}}},
+            {sdbus::PropertyName{"Size"},
+             sdbus::Variant{disk_size / kPartitions}},
+            {sdbus::PropertyName{"Table"},
+             sdbus::Variant{sdbus::ObjectPath{std::format(
+                 "/org/freedesktop/UDisks2/block_devices/{}", name)}}}}},
+          {sdbus::InterfaceName{kFilesystemInterfaceName},
+           {{sdbus::PropertyName{"MountPoints"},
+             sdbus::Variant{std::move(mount_points)}},
+            {sdbus::PropertyName{"Size"},
+             sdbus::Variant{disk_size / kPartitions}}}}};
+      objects.emplace_back(
+          sdbus::ObjectPath{std::format(
+              "/org/freedesktop/UDisks2/block_devices/{}", part_name)},
+          std::move(interfaces));
+    }
+  }
+
+  return objects;
+}
+
+/// Objects of a recording: those found at startup, and those added later.
+std::vector<Object> RecordedObjects(const char* path) {
+  record::Reader reader{path};
+  std::vector<Object> objects{};
+  while (auto record{reader.Next()}) {
+    if (record->kind == record::Kind::kManagedObject ||
+        record->kind == record::Kind::kInterfacesAdded) {
+      objects.emplace_back(std::move(record->object_path),
+                           std::move(record->interfaces));
+    }
+  }
+
+  return objects;
+}
+
+/// Payloads shared by the benchmarks, built once.
+const std::vector<Object>& Objects() {
+  static const auto objects{[] {
+    const char* const path{std::getenv("UDISKEN_BENCH_RECORDING")};
+    return path != nullptr ? RecordedObjects(path) : MadeUpObjects();
+  }()};
+
+  return objects;
+}
+
+/// MountPoints values of the filesystems.
+const std::vector<RawMountPoints>& MountPoints() {
+  static const auto mount_points{[] {
+    std::vector<RawMountPoints> values{};
+    for (const auto& [path, interfaces] : Objects()) {
+      const auto fs{
+          interfaces.find(sdbus::InterfaceName{kFilesystemInterfaceName})};
+      if (fs == interfaces.end()) {
+        continue;
+      }
+      if (const auto it{fs->second.find(sdbus::PropertyName{"MountPoints"})};
+          it != fs->second.end() &&
+          it->second.containsValueOfType<RawMountPoints>()) {
+        values.push_back(it->second.get<RawMountPoints>());
+      }
+    }
+
+    return values;
+  }()};
+
+  return mount_points;
+}
+
+void BM_ConvertArrayArrayByte(benchmark::State& state) {
+  const auto& mount_points{MountPoints()};
+  if (mount_points.empty()) {
+    state.SkipWithError("no filesystems in the payload");
+    return;
+  }
+
+  std::size_t index{0};
+  const AllocationCounter counter{state};
+  for (auto _ : state) {
+    auto converted{mount::ConvertArrayArrayByte(mount_points[index])};
+    benchmark::DoNotOptimize(converted);
+    index = (index + 1) % mount_points.size();
+  }
+}
+BENCHMARK(BM_ConvertArrayArrayByte);
+
+void BM_ViewArrayArrayByte(benchmark::State& state) {
+  const auto& mount_points{MountPoints()};
+  if (mount_points.empty()) {
+    state.SkipWithError("no filesystems in the payload");
+    return;
+  }
+
+  std::size_t index{0};
+  const AllocationCounter counter{state};
+  for (auto _ : state) {
+    // As when handling an event.
+    arena::EventArena arena{};
+    auto views{
+        mount::ViewArrayArrayByte(mount_points[index], arena.Resource())};
+    benchmark::DoNotOptimize(views);
+    index = (index + 1) % mount_points.size();
+  }
+}
+BENCHMARK(BM_ViewArrayArrayByte);
+
+void BM_NonZero(benchmark::State& state) {
+  constexpr std::array<std::string_view, 6> kValues{"",    "0",   "1",
+                                                    "000", "010", "true"};
+
+  std::size_t index{0};
+  const AllocationCounter counter{state};
+  for (auto _ : state) {
+    std::string_view value{kValues[index]};
+    benchmark::DoNotOptimize(value);
+    bool non_zero{options::NonZero(value)};
+    benchmark::DoNotOptimize(non_zero);
+    index = (index + 1) % kValues.size();
+  }
+}
+BENCHMARK(BM_NonZero);
+
+/// @param value Value of the variable; nullptr to leave it unset.
+void BM_NonZeroEnvVar(benchmark::State& state, const char* value) {
+  const std::string var{"UDISKEN_BENCH_VAR"};
+  if (value != nullptr) {
+    setenv(var.c_str(), value, 1);
+  } else {
+    unsetenv(var.c_str());
+  }
+
+  const AllocationCounter counter{state};
+  for (auto _ : state) {
+    bool non_zero{options::NonZeroEnvVar(var)};
+    benchmark::DoNotOptimize(non_zero);
+  }
+}
+BENCHMARK_CAPTURE(BM_NonZeroEnvVar, unset, nullptr);
+BENCHMARK_CAPTURE(BM_NonZeroEnvVar, zero, "0");
+BENCHMARK_CAPTURE(BM_NonZeroEnvVar, one, "1");
+
+void BM_HasInterface(benchmark::State& state) {
+  const auto& objects{Objects()};
+
+  const AllocationCounter counter{state};
+  for (auto _ : state) {
+    std::size_t filesystems{0};
+    for (const auto& [path, interfaces] : objects) {
+      filesystems += managers::HasInterface<
+          udisks_sd::proxy_wrappers::UdisksFilesystem>(interfaces);
+    }
+    benchmark::DoNotOptimize(filesystems);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(objects.size()));
+}
+BENCHMARK(BM_HasInterface);
+
+/// Interface lists, as sent in InterfacesRemoved signals.
+void BM_HasInterfaceRemoved(benchmark::State& state) {
+  std::vector<std::vector<sdbus::InterfaceName>> removed{};
+  for (const auto& [path, interfaces] : Objects()) {
+    auto& names{removed.emplace_back()};
+    for (const auto& interface : interfaces) {
+      names.push_back(interface.first);
+    }
+  }
+
+  const AllocationCounter counter{state};
+  for (auto _ : state) {
+    std::size_t filesystems{0};
+    for (const auto& names : removed) {
+      filesystems += managers::HasInterface<
+          udisks_sd::proxy_wrappers::UdisksFilesystem>(names);
+    }
+    benchmark::DoNotOptimize(filesystems);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(removed.size()));
+}
+BENCHMARK(BM_HasInterfaceRemoved);
+
+/// Caching the properties of each announced object and deciding whether to
+/// reject it early, as for InterfacesAdded signals, before any proxy is made.
+/// The cached properties are not on an arena: they outlive the event.
+void BM_InterfacesAddedChecks(benchmark::State& state) {
+  const auto& objects{Objects()};
+
+  const AllocationCounter counter{state};
+  for (auto _ : state) {
+    std::size_t rejected{0};
+    for (const auto& [path, interfaces] : objects) {
+      if (!managers::HasInterface<udisks_sd::proxy_wrappers::UdisksBlock>(
+              interfaces)) {
+        continue;
+      }
+      objects::BlockProperties properties{};
+      for (const auto& [interface, changed] : interfaces) {
+        properties.Update(interface, changed);
+      }
+      rejected += mount::RejectReason(properties, policy::Decision{})
+                      .has_value();
+      benchmark::DoNotOptimize(properties);
+    }
+    benchmark::DoNotOptimize(rejected);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(objects.size()));
+}
+BENCHMARK(BM_InterfacesAddedChecks);
+
+/// @param state Its argument is the number of filesystems listed.
+void BM_MountedNotification(benchmark::State& state) {
+  std::vector<mount::MountedFilesystem> mounts{};
+  for (std::int64_t i{0}; i < state.range(0); ++i) {
+    mounts.push_back(mount::MountedFilesystem{
+        .name = std::format("ST4000NM000A Partition {}", i + 1),
+        .mnt_point = std::format("/run/media/user/data{}", i + 1)});
+  }
+
+  const AllocationCounter counter{state};
+  for (auto _ : state) {
+    auto notif{mount::MountedNotification(mounts, "drive-harddisk", 0)};
+    benchmark::DoNotOptimize(notif);
+  }
+}
+BENCHMARK(BM_MountedNotification)->Arg(1)->Arg(4)->Arg(16);
+
+}  // namespace
+
+BENCHMARK_MAIN();
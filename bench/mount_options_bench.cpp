@@ -0,0 +1,272 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Mount option profile benchmark.
+///
+/// Sets up a loop device from a filesystem image through the real UDisks on
+/// the system bus, then mounts it in turn with UDisks' default options and
+/// with the options of the profile UDISKEN picks for a flash drive, and
+/// reports the throughput of a small-file workload under each:
+/// - writing files, then syncing the filesystem;
+/// - reading them back, then syncing again, which writes out the access times
+///   that the options did not avoid.
+///
+/// Create the image beforehand, e.g.:
+///   truncate -s 512M bench.img && mkfs.vfat bench.img
+/// Setting up a loop device needs an active session or polkit authorization.
+/// Stop UDISKEN first, or it would automount the loop device itself.
+
+#include "profiles.hpp"
+#include "udisks.hpp"
+
+#include <argparse/argparse.hpp>
+#include <fcntl.h>
+#include <sdbus-c++/sdbus-c++.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto kManagerInterfaceName{"org.freedesktop.UDisks2.Manager"};
+constexpr auto kBlockInterfaceName{"org.freedesktop.UDisks2.Block"};
+constexpr auto kFilesystemInterfaceName{"org.freedesktop.UDisks2.Filesystem"};
+constexpr auto kLoopInterfaceName{"org.freedesktop.UDisks2.Loop"};
+
+constexpr std::chrono::milliseconds kPollInterval{50};
+constexpr std::chrono::seconds kTimeout{10};
+
+/// Loop device set up by UDisks, deleted when going out of scope.
+class LoopDevice {
+ public:
+  LoopDevice(sdbus::IConnection& connection, const std::string& image) {
+    const int fd{open(image.c_str(), O_RDWR | O_CLOEXEC)};
+    if (fd < 0) {
+      throw std::system_error{errno, std::generic_category(),
+                              "could not open " + image};
+    }
+
+    const auto manager{sdbus::createProxy(
+        connection, udisks::kServiceName,
+        sdbus::ObjectPath{managers::UdisksManager::kObjectPath})};
+    sdbus::ObjectPath object_path{};
+    manager->callMethod("LoopSetup")
+        .onInterface(kManagerInterfaceName)
+        .withArguments(sdbus::UnixFd{fd, sdbus::adopt_fd},
+                       profiles::MountOptions{})
+        .storeResultsTo(object_path);
+    proxy_ = sdbus::createProxy(connection, udisks::kServiceName,
+                                std::move(object_path));
+  }
+
+  LoopDevice(const LoopDevice&) = delete;
+  LoopDevice(LoopDevice&&) = delete;
+  LoopDevice& operator=(const LoopDevice&) = delete;
+  LoopDevice& operator=(LoopDevice&&) = delete;
+
+  ~LoopDevice() noexcept {
+    try {
+      proxy_->callMethod("Delete")
+          .onInterface(kLoopInterfaceName)
+          .withArguments(profiles::MountOptions{});
+    } catch (const sdbus::Error& e) {
+      spdlog::error("Could not delete the loop device: {}", e.what());
+    }
+  }
+
+  sdbus::IProxy& Proxy() { return *proxy_; }
+
+ private:
+  std::unique_ptr<sdbus::IProxy> proxy_{};
+};
+
+/// Wait until UDisks probed the filesystem of a block device.
+///
+/// @return Type of the filesystem; empty if it was not probed in time.
+std::string WaitForFilesystem(sdbus::IProxy& block) {
+  for (const auto deadline{Clock::now() + kTimeout}; Clock::now() < deadline;
+       std::this_thread::sleep_for(kPollInterval)) {
+    const auto usage{block.getProperty("IdUsage")
+                         .onInterface(kBlockInterfaceName)
+                         .get<std::string>()};
+    if (usage == "filesystem") {
+      return block.getProperty("IdType")
+          .onInterface(kBlockInterfaceName)
+          .get<std::string>();
+    }
+  }
+
+  return {};
+}
+
+struct Result {
+  Clock::duration write{};
+  Clock::duration read{};
+};
+
+/// Write files to a directory, then read them back, syncing the filesystem
+/// after each pass.
+Result RunWorkload(const std::filesystem::path& dir, std::uint32_t files,
+                   std::uint32_t file_size) {
+  const std::vector<char> data(file_size, 'u');
+  std::vector<char> buffer(file_size);
+  std::filesystem::create_directory(dir);
+  const int dir_fd{open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+
+  Result result{};
+  const auto write_start{Clock::now()};
+  for (std::uint32_t i{0}; i < files; ++i) {
+    std::ofstream file{dir / std::to_string(i), std::ios::binary};
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+  }
+  syncfs(dir_fd);
+  result.write = Clock::now() - write_start;
+
+  const auto read_start{Clock::now()};
+  for (std::uint32_t i{0}; i < files; ++i) {
+    std::ifstream file{dir / std::to_string(i), std::ios::binary};
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  }
+  syncfs(dir_fd);
+  result.read = Clock::now() - read_start;
+
+  close(dir_fd);
+  std::filesystem::remove_all(dir);
+
+  return result;
+}
+
+/// Mount the filesystem with some options, run the workload, and unmount it.
+///
+/// @return Best result of a few rounds.
+Result Measure(sdbus::IProxy& filesystem, const profiles::MountOptions& options,
+               std::uint32_t rounds, std::uint32_t files,
+               std::uint32_t file_size) {
+  std::string mnt_point{};
+  filesystem.callMethod("Mount")
+      .onInterface(kFilesystemInterfaceName)
+      .withArguments(options)
+      .storeResultsTo(mnt_point);
+
+  Result best{.write = Clock::duration::max(), .read = Clock::duration::max()};
+  for (std::uint32_t round{0}; round < rounds; ++round) {
+    const auto result{RunWorkload(
+        std::filesystem::path{mnt_point} / "udisken-bench", files, file_size)};
+    best.write = std::min(best.write, result.write);
+    best.read = std::min(best.read, result.read);
+  }
+
+  filesystem.callMethod("Unmount")
+      .onInterface(kFilesystemInterfaceName)
+      .withArguments(profiles::MountOptions{});
+
+  return best;
+}
+
+/// Throughput in MiB/s.
+double Throughput(std::uint64_t bytes, Clock::duration duration) {
+  return static_cast<double>(bytes) / (1024.0 * 1024.0) /
+         std::chrono::duration<double>(duration).count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  argparse::ArgumentParser program{"mount-options-bench"};
+  program.add_argument("image").help("path to a filesystem image");
+  program.add_argument("--files")
+      .help("number of files written and read per round")
+      .default_value(std::uint32_t{2000})
+      .scan<'u', std::uint32_t>();
+  program.add_argument("--file-size")
+      .help("size of each file, in bytes")
+      .default_value(std::uint32_t{16 * 1024})
+      .scan<'u', std::uint32_t>();
+  program.add_argument("--rounds")
+      .help("rounds per set of options, keeping the best")
+      .default_value(std::uint32_t{3})
+      .scan<'u', std::uint32_t>();
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::exception& e) {
+    spdlog::critical("{}", e.what());
+    std::cerr << program;
+    return EXIT_FAILURE;
+  }
+  const auto files{program.get<std::uint32_t>("--files")};
+  const auto file_size{program.get<std::uint32_t>("--file-size")};
+  const auto rounds{program.get<std::uint32_t>("--rounds")};
+
+  try {
+    const auto connection{sdbus::createSystemBusConnection()};
+    LoopDevice loop_device{*connection, program.get<std::string>("image")};
+
+    objects::BlockProperties blk{};
+    blk.id_type = WaitForFilesystem(loop_device.Proxy());
+    if (blk.id_type.empty()) {
+      spdlog::critical("UDisks found no filesystem on the image");
+      return EXIT_FAILURE;
+    }
+    // Loop devices have no drive: pretend to be a USB flash drive.
+    const objects::DriveProperties drive{.removable = true,
+                                         .connection_bus = "usb",
+                                         .rotation_rate = 0};
+    const auto& profile{profiles::Select(blk, &drive)};
+    const auto profile_options{
+        profile.contains("options")
+            ? profile.at("options").get<std::string>()
+            : std::string{}};
+
+    const auto defaults{Measure(loop_device.Proxy(), profiles::MountOptions{},
+                                rounds, files, file_size)};
+    const auto profiled{
+        Measure(loop_device.Proxy(), profile, rounds, files, file_size)};
+
+    const std::uint64_t bytes{std::uint64_t{files} * file_size};
+    std::cout << std::format(
+        "{} files of {} bytes on {}\n"
+        "UDisks defaults: write {:.1f} MiB/s, read {:.1f} MiB/s\n"
+        "profile \"{}\": write {:.1f} MiB/s, read {:.1f} MiB/s\n",
+        files, file_size, blk.id_type, Throughput(bytes, defaults.write),
+        Throughput(bytes, defaults.read), profile_options,
+        Throughput(bytes, profiled.write), Throughput(bytes, profiled.read));
+  } catch (const std::exception& e) {
+    spdlog::critical("{}", e.what());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
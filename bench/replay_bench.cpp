@@ -0,0 +1,489 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Replay of recorded UDisks traffic, as a benchmark.
+///
+/// Serves a recording made by `udisken --record` from a stub UDisks, running
+/// in this process on its own loop and connection to the session bus, which
+/// should be a private one (see dbus-run-session(1)). UDISKEN's object manager
+/// scans the recorded objects, then the recorded signals are sent to it, and
+/// its Mount calls get the recorded replies. Reports:
+/// - the throughput of UDISKEN going through the recorded signals, each sent
+///   once it has handled the previous one, up to the end of the mounts they
+///   started;
+/// - the latencies of UDISKEN's pipeline stages, as exported by its Stats.
+///
+/// Mount calls are answered in the order they were recorded for each device;
+/// extra calls fail. Notifications are disabled: the recording holds none.
+/// Block devices not on removable drives are not throttled, so that all
+/// mounts are measured rather than the throttle's interval.
+
+#include "loop.hpp"
+#include "mount.hpp"
+#include "record.hpp"
+#include "stats.hpp"
+#include "udisks.hpp"
+
+#include <argparse/argparse.hpp>
+#include <sdbus-c++/sdbus-c++.h>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <format>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using MountOptions = std::map<std::string, sdbus::Variant>;
+
+constexpr auto kFilesystemInterfaceName{"org.freedesktop.UDisks2.Filesystem"};
+constexpr auto kFailedErrorName{"org.freedesktop.UDisks2.Error.Failed"};
+
+/// Time between checks that UDISKEN is done with the recording.
+constexpr std::chrono::milliseconds kPollInterval{5};
+
+enum class Speed {
+  /// Send each signal once UDISKEN has handled the previous one, as told by a
+  /// ping it answers after it. Mounts started by a signal may still be in
+  /// progress.
+  kFast,
+  /// Send signals and Mount replies as spaced out as they were recorded.
+  kOriginal,
+};
+
+/// Property of a stub interface, typed as its recorded value.
+///
+/// @param properties Values of the interface's properties, read by the
+/// getter; must outlive the property.
+template <std::size_t kIndex = 0>
+sdbus::VTableItem RegisterProperty(const sdbus::PropertyName& name,
+                                   const objects::PropertyMap& properties) {
+  using T = std::tuple_element_t<kIndex, record::ValueTypes>;
+  if constexpr (kIndex + 1 < std::tuple_size_v<record::ValueTypes>) {
+    if (!properties.at(name).containsValueOfType<T>()) {
+      return RegisterProperty<kIndex + 1>(name, properties);
+    }
+  }
+
+  return sdbus::registerProperty(name).withGetter(
+      [&properties, name] { return properties.at(name).get<T>(); });
+}
+
+/// Stub UDisks serving the objects of a recording, and replaying its signals
+/// and Mount replies. Used from its loop's thread only, once running.
+class StubUdisks {
+ public:
+  /// @param connection Session bus connection, dispatched on the loop.
+  /// @param records The recording; must outlive the stub.
+  /// @param udisken Unique bus name of UDISKEN's connection.
+  StubUdisks(sdbus::IConnection& connection, loop::MainLoop& loop,
+             const std::vector<record::Record>& records,
+             const sdbus::BusName& udisken, Speed speed)
+      : connection_{&connection},
+        loop_{&loop},
+        records_{&records},
+        speed_{speed},
+        manager_{sdbus::createObject(connection,
+                                     sdbus::ObjectPath{udisks::kObjectPath})},
+        udisken_{sdbus::createProxy(connection, sdbus::ServiceName{udisken},
+                                    sdbus::ObjectPath{"/"})} {
+    manager_->addObjectManager();
+
+    for (const auto& record : records) {
+      if (record.kind == record::Kind::kManagedObject) {
+        Add(record, false);
+      } else if (record.kind == record::Kind::kMountReply) {
+        replies_[record.object_path].push_back(&record);
+      }
+    }
+  }
+
+  /// Replay the recorded signals, from the loop's thread.
+  ///
+  /// @param done Called with the time UDISKEN took to go through them, once
+  /// it has handled the last one and made its Mount calls.
+  void Start(std::function<void(Clock::duration)> done) {
+    done_ = std::move(done);
+    start_ = Clock::now();
+    Next();
+  }
+
+  /// Signals sent to UDISKEN.
+  std::size_t Signals() const { return signals_; }
+  /// Mount calls received from UDISKEN.
+  std::size_t MountCalls() const { return mount_calls_; }
+
+ private:
+  struct Interface {
+    /// Read by the property getters.
+    objects::PropertyMap properties;
+    sdbus::Slot slot{};
+  };
+
+  /// Interfaces of an object, by name.
+  using Interfaces = std::map<sdbus::InterfaceName, Interface>;
+
+  /// Send the next recorded signal, then schedule the one after it.
+  void Next() {
+    while (next_ < records_->size()) {
+      const auto& record{(*records_)[next_]};
+      if (record.kind == record::Kind::kInterfacesAdded ||
+          record.kind == record::Kind::kInterfacesRemoved ||
+          record.kind == record::Kind::kPropertiesChanged) {
+        break;
+      }
+      ++next_;
+    }
+    if (next_ == records_->size()) {
+      Settle();
+      return;
+    }
+
+    const auto& record{(*records_)[next_]};
+    if (speed_ == Speed::kOriginal) {
+      if (!first_time_) {
+        first_time_ = record.time;
+      }
+      if (const auto due{start_ + (record.time - *first_time_)};
+          Clock::now() < due) {
+        loop_->AddTimer(due - Clock::now(), [this] { Next(); });
+        return;
+      }
+    }
+
+    switch (record.kind) {
+      case record::Kind::kInterfacesAdded:
+        Add(record, true);
+        break;
+      case record::Kind::kInterfacesRemoved:
+        Remove(record);
+        break;
+      default:
+        Change(record);
+        break;
+    }
+    ++signals_;
+    ++next_;
+    if (speed_ == Speed::kOriginal) {
+      // Let the loop dispatch UDISKEN's calls before the next signal.
+      loop_->Defer([this] { Next(); });
+      return;
+    }
+    Ping([this] { Next(); });
+  }
+
+  /// Register the recorded interfaces of an object.
+  ///
+  /// @param announce Emit InterfacesAdded for them.
+  void Add(const record::Record& record, bool announce) {
+    auto& [object, interfaces]{objects_[record.object_path]};
+    if (!object) {
+      object = sdbus::createObject(*connection_, record.object_path);
+    }
+
+    std::vector<sdbus::InterfaceName> added{};
+    for (const auto& [name, properties] : record.interfaces) {
+      if (interfaces.contains(name)) {
+        continue;
+      }
+      auto& interface{interfaces[name]};
+      interface.properties = properties;
+
+      std::vector<sdbus::VTableItem> vtable{};
+      for (const auto& property : interface.properties) {
+        vtable.push_back(
+            RegisterProperty(property.first, interface.properties));
+      }
+      if (name == kFilesystemInterfaceName) {
+        vtable.push_back(
+            sdbus::registerMethod("Mount")
+                .withInputParamNames("options")
+                .withOutputParamNames("mount_path")
+                .implementedAs([this, path = record.object_path](
+                                   sdbus::Result<std::string>&& result,
+                                   [[maybe_unused]] MountOptions options) {
+                  Mount(path, std::move(result));
+                }));
+      }
+      interface.slot =
+          object->addVTable(name, std::move(vtable), sdbus::return_slot);
+      added.push_back(name);
+    }
+
+    if (announce && !added.empty()) {
+      object->emitInterfacesAddedSignal(added);
+    }
+  }
+
+  /// Emit InterfacesRemoved, then unregister the interfaces.
+  void Remove(const record::Record& record) {
+    const auto it{objects_.find(record.object_path)};
+    if (it == objects_.end()) {
+      return;
+    }
+
+    auto& [object, interfaces]{it->second};
+    object->emitInterfacesRemovedSignal(record.removed);
+    for (const auto& name : record.removed) {
+      interfaces.erase(name);
+    }
+    if (interfaces.empty()) {
+      objects_.erase(it);
+    }
+  }
+
+  /// Update the values of properties, and emit PropertiesChanged for them.
+  /// Properties the object did not have are left out.
+  void Change(const record::Record& record) {
+    const auto object{objects_.find(record.object_path)};
+    if (object == objects_.end() || record.interfaces.empty()) {
+      return;
+    }
+    const auto& [name, changed]{*record.interfaces.begin()};
+    const auto interface{object->second.interfaces.find(name)};
+    if (interface == object->second.interfaces.end()) {
+      return;
+    }
+
+    auto& properties{interface->second.properties};
+    std::vector<sdbus::PropertyName> names{};
+    for (const auto& [property, value] : changed) {
+      if (const auto it{properties.find(property)}; it != properties.end()) {
+        it->second = value;
+        names.push_back(property);
+      }
+    }
+    // Their values were not recorded: announce the old ones again.
+    for (const auto& property : record.invalidated) {
+      if (properties.contains(property)) {
+        names.push_back(property);
+      }
+    }
+
+    if (!names.empty()) {
+      object->second.object->emitPropertiesChangedSignal(name, names);
+    }
+  }
+
+  /// Answer a Mount call with the next reply recorded for the object.
+  void Mount(const sdbus::ObjectPath& object_path,
+             sdbus::Result<std::string>&& result) {
+    ++mount_calls_;
+
+    auto& replies{replies_[object_path]};
+    if (replies.empty()) {
+      result.returnError(sdbus::Error{sdbus::Error::Name{kFailedErrorName},
+                                      "No more replies were recorded"});
+      return;
+    }
+    const record::Record& reply{*replies.front()};
+    replies.pop_front();
+
+    auto send{[result = std::make_shared<sdbus::Result<std::string>>(
+                   std::move(result)),
+               &reply] {
+      if (reply.error_name.empty()) {
+        result->returnResults(reply.mount_point);
+      } else {
+        result->returnError(sdbus::Error{sdbus::Error::Name{reply.error_name},
+                                         "Recorded error"});
+      }
+    }};
+    if (speed_ == Speed::kFast) {
+      send();
+      return;
+    }
+
+    ++pending_replies_;
+    loop_->AddTimer(reply.duration, [this, send = std::move(send)] {
+      send();
+      --pending_replies_;
+    });
+  }
+
+  /// Ping UDISKEN: its connection answers pings in order with the signals,
+  /// once it has handled those sent before.
+  ///
+  /// @param then Called once UDISKEN answered; the replay ends instead if it
+  /// could not be pinged.
+  void Ping(std::function<void()> then) {
+    auto ping{udisken_->createMethodCall(
+        sdbus::InterfaceName{"org.freedesktop.DBus.Peer"},
+        sdbus::MethodName{"Ping"})};
+    ping_ = udisken_->callMethodAsync(
+        ping, [this, then = std::move(then)](
+                  [[maybe_unused]] sdbus::MethodReply reply,
+                  std::optional<sdbus::Error> error) {
+          if (error) {
+            spdlog::error("Could not ping UDISKEN: {}", error->what());
+            done_(Clock::now() - start_);
+            return;
+          }
+          then();
+        });
+  }
+
+  /// Ping UDISKEN until it has handled every signal, and stopped making Mount
+  /// calls.
+  void Settle() {
+    Ping([this, mount_calls = mount_calls_] {
+      if (mount_calls != mount_calls_ || pending_replies_ > 0) {
+        loop_->AddTimer(kPollInterval, [this] { Settle(); });
+        return;
+      }
+      done_(Clock::now() - start_);
+    });
+  }
+
+  sdbus::IConnection* connection_;
+  loop::MainLoop* loop_;
+  const std::vector<record::Record>* records_;
+  Speed speed_;
+
+  std::unique_ptr<sdbus::IObject> manager_;
+  std::unique_ptr<sdbus::IProxy> udisken_;
+  std::map<sdbus::ObjectPath,
+           std::pair<std::unique_ptr<sdbus::IObject>, Interfaces>>
+      objects_{};
+  /// Mount replies not sent yet, by object path.
+  std::map<sdbus::ObjectPath, std::deque<const record::Record*>> replies_{};
+
+  std::function<void(Clock::duration)> done_{};
+  Clock::time_point start_{};
+  /// Recorded time of the first signal, at original speed.
+  std::optional<std::chrono::nanoseconds> first_time_{};
+  /// Index of the next record to look at.
+  std::size_t next_{0};
+  std::size_t signals_{0};
+  std::size_t mount_calls_{0};
+  /// Mount replies waiting for their recorded duration.
+  std::size_t pending_replies_{0};
+  sdbus::PendingAsyncCall ping_{};
+};
+
+/// Read a whole recording.
+///
+/// @throws std::system_error Could not open the file.
+/// @throws std::runtime_error Not a valid recording.
+std::vector<record::Record> Load(const std::string& path) {
+  record::Reader reader{path};
+  std::vector<record::Record> records{};
+  while (auto record{reader.Next()}) {
+    records.push_back(std::move(*record));
+  }
+
+  return records;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  argparse::ArgumentParser program{"replay-bench"};
+  program.add_argument("recording").help("file written by udisken --record");
+  program.add_argument("--speed")
+      .help("'fast' to replay as fast as UDISKEN keeps up, or 'original'")
+      .default_value(std::string{"fast"})
+      .choices("fast", "original");
+  try {
+    program.parse_args(argc, argv);
+  } catch (const std::exception& e) {
+    spdlog::critical("{}", e.what());
+    std::cerr << program;
+    return EXIT_FAILURE;
+  }
+  const auto speed{program.get<std::string>("--speed") == "original"
+                       ? Speed::kOriginal
+                       : Speed::kFast};
+
+  std::vector<record::Record> records{};
+  try {
+    records = Load(program.get<std::string>("recording"));
+  } catch (const std::exception& e) {
+    spdlog::critical("Could not read the recording: {}", e.what());
+    return EXIT_FAILURE;
+  }
+
+  // Measure UDISKEN, not its logging to the terminal.
+  spdlog::set_level(spdlog::level::warn);
+
+  // The private session bus plays the part of the system bus too.
+  const auto connection{sdbus::createSessionBusConnection()};
+  const auto stub_connection{sdbus::createSessionBusConnection()};
+  loop::MainLoop stub_loop{};
+  StubUdisks stub{*stub_connection, stub_loop, records,
+                  connection->getUniqueName(), speed};
+  stub_connection->requestName(udisks::kServiceName);
+  stub_loop.AddConnection(*stub_connection);
+  std::thread stub_thread{[&stub_loop] { stub_loop.Run(); }};
+
+  loop::MainLoop main_loop{};
+  managers::UdisksObjectManager obj_mgr{
+      *connection,
+      mount::Context{.loop = &main_loop,
+                     .throttle_interval = std::chrono::milliseconds::zero()}};
+  main_loop.AddConnection(*connection);
+  std::thread loop_thread{[&main_loop] { main_loop.Run(); }};
+
+  std::promise<Clock::duration> done{};
+  stub_loop.Defer([&stub, &done] {
+    stub.Start([&done](Clock::duration elapsed) { done.set_value(elapsed); });
+  });
+  const auto elapsed{done.get_future().get()};
+
+  main_loop.Quit();
+  loop_thread.join();
+  stub_loop.Quit();
+  stub_thread.join();
+
+  const auto elapsed_us{
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()};
+  std::cout << std::format(
+      "{} records, {} signals in {} us: {:.0f} signals/s; {} mount calls\n",
+      records.size(), stub.Signals(), elapsed_us,
+      elapsed_us > 0 ? static_cast<double>(stub.Signals()) * 1e6 /
+                           static_cast<double>(elapsed_us)
+                     : 0.0,
+      stub.MountCalls());
+  for (std::size_t stage{0}; stage < stats::kStages; ++stage) {
+    const auto summary{stats::Global().latencies[stage].Summarize()};
+    std::cout << std::format(
+        "{} ({}): p50 {} us, p90 {} us, p99 {} us, max {} us\n",
+        stats::Name(static_cast<stats::Stage>(stage)), summary.count,
+        summary.p50_us, summary.p90_us, summary.p99_us, summary.max_us);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Arenas for the transient structures of one event.
+
+#ifndef UDISKEN_ARENA_HPP_
+#define UDISKEN_ARENA_HPP_
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+/// Arenas for the transient structures of one event.
+namespace arena {
+
+/// Monotonic arena over a buffer it holds, for the transient structures of
+/// one event: they are released in one shot with the arena, rather than one
+/// by one to the heap. Structures outgrowing the buffer spill to the heap.
+/// Only the storage of pmr containers comes from the arena: their elements
+/// allocating on their own, such as std::string, still use the heap. So do
+/// the properties cached from an event, such as objects::BlockProperties,
+/// which outlive it: handling an event is not free of heap allocations.
+///
+/// Meant to live on the stack of the function handling the event, not in a
+/// coroutine frame, which is itself on the heap.
+///
+/// @tparam kSize Size of the buffer, in bytes.
+template <std::size_t kSize>
+class Arena {
+ public:
+  // Not defaulted: Arena{} would then zero the buffer first.
+  Arena() {}
+
+  Arena(const Arena&) = delete;
+  Arena(Arena&&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena& operator=(Arena&&) = delete;
+
+  ~Arena() noexcept = default;
+
+  std::pmr::memory_resource* Resource() { return &resource_; }
+
+ private:
+  // Left uninitialized: whatever is allocated from it is constructed there.
+  std::array<std::byte, kSize> buffer_;
+  std::pmr::monotonic_buffer_resource resource_{buffer_.data(), kSize};
+};
+
+/// Arena of one UDisks signal; enough for the properties of a block device.
+using EventArena = Arena<4096>;
+
+}  // namespace arena
+
+#endif  // UDISKEN_ARENA_HPP_
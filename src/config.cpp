@@ -0,0 +1,287 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Runtime configuration, from a file reloaded when it changes.
+
+#include "config.hpp"
+
+#include "loop.hpp"
+#include "options.hpp"
+#include "policy.hpp"
+
+#include <spdlog/spdlog.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace config {
+
+namespace {
+
+/// Editors write files in several steps: reload once they are done.
+constexpr std::chrono::milliseconds kSettleDelay{100};
+
+std::string_view Trim(std::string_view sv) {
+  const auto begin{sv.find_first_not_of(" \t\r")};
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+
+  return sv.substr(begin, sv.find_last_not_of(" \t\r") - begin + 1);
+}
+
+std::optional<bool> ParseBool(std::string_view value) {
+  if (value == "true" || value == "yes" || value == "1") {
+    return true;
+  }
+  if (value == "false" || value == "no" || value == "0") {
+    return false;
+  }
+
+  return std::nullopt;
+}
+
+/// Contents of a file; nullopt if it cannot be read, such as when it does not
+/// exist.
+std::optional<std::string> ReadFile(const std::filesystem::path& path) {
+  std::ifstream file{path};
+  if (!file) {
+    return std::nullopt;
+  }
+
+  return std::string{std::istreambuf_iterator<char>{file},
+                     std::istreambuf_iterator<char>{}};
+}
+
+}  // namespace
+
+options::Options ParseOptions(std::string_view text, std::string_view source) {
+  options::Options options{};
+  std::size_t line_number{0};
+  for (const auto part : std::views::split(text, '\n')) {
+    ++line_number;
+    const auto line{Trim(std::string_view{part.begin(), part.end()})};
+    if (line.empty() || line.starts_with('#')) {
+      continue;
+    }
+
+    const auto equal{line.find('=')};
+    if (equal == std::string_view::npos) {
+      spdlog::warn("{}:{}: expected 'key = value'; ignoring line", source,
+                   line_number);
+      continue;
+    }
+    const auto key{Trim(line.substr(0, equal))};
+    const auto value{Trim(line.substr(equal + 1))};
+
+    if (key == "notify") {
+      if (const auto notify{ParseBool(value)}) {
+        options.notify = *notify;
+      } else {
+        spdlog::warn("{}:{}: expected true or false; ignoring line", source,
+                     line_number);
+      }
+    } else if (key == "notify-window") {
+      std::uint32_t window{};
+      const auto* const value_end{value.data() + value.size()};
+      if (const auto [end, error]{
+              std::from_chars(value.data(), value_end, window)};
+          error == std::errc{} && end == value_end) {
+        options.notify_window = std::chrono::milliseconds{window};
+      } else {
+        spdlog::warn("{}:{}: expected milliseconds; ignoring line", source,
+                     line_number);
+      }
+    } else {
+      spdlog::warn("{}:{}: unknown setting '{}'; ignoring line", source,
+                   line_number, key);
+    }
+  }
+
+  return options;
+}
+
+Config::Config(loop::MainLoop* loop, std::filesystem::path config_path,
+               std::filesystem::path policy_path, Overrides overrides)
+    : loop_{loop},
+      config_path_{std::move(config_path)},
+      policy_path_{std::move(policy_path)},
+      overrides_{overrides} {
+  Reload();
+  if (loop_ != nullptr) {
+    Watch();
+  }
+}
+
+Config::~Config() noexcept {
+  if (reload_timer_) {
+    loop_->Remove(*reload_timer_);
+  }
+  if (watch_) {
+    loop_->Remove(*watch_);
+  }
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+  }
+}
+
+std::filesystem::path Config::DefaultPath() {
+  return options::ConfigDir() / "config";
+}
+
+void Config::Reload() {
+  reload_timer_.reset();
+
+  auto next{std::make_unique<Snapshot>()};
+  if (const auto text{ReadFile(config_path_)}) {
+    next->options = ParseOptions(*text, config_path_.string());
+  } else {
+    SPDLOG_DEBUG("No config file at {}", config_path_.string());
+  }
+  if (overrides_.notify) {
+    next->options.notify = *overrides_.notify;
+  }
+  if (overrides_.notify_window) {
+    next->options.notify_window = *overrides_.notify_window;
+  }
+  next->policy = policy::Policy::Load(policy_path_);
+
+  current_.store(next.get(), std::memory_order_release);
+  // Frees the previous snapshot.
+  snapshot_ = std::move(next);
+}
+
+void Config::Watch() {
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    spdlog::warn("Not watching the config files for changes: {}",
+                 std::system_category().message(errno));
+
+    return;
+  }
+
+  AddWatches();
+  watch_ = loop_->Watch(inotify_fd_, EPOLLIN,
+                        [this](std::uint32_t /*events*/) { OnEvents(); });
+}
+
+void Config::AddWatches() {
+  for (const auto& [wd, name] : watched_) {
+    inotify_rm_watch(inotify_fd_, wd);
+  }
+  watched_.clear();
+  missing_dirs_ = false;
+
+  // Directories are watched rather than files, since editors usually replace
+  // files instead of writing to them.
+  for (const auto* const path : {&config_path_, &policy_path_}) {
+    auto dir{path->has_parent_path() ? path->parent_path()
+                                     : std::filesystem::path{"."}};
+    auto name{path->filename()};
+    std::error_code error{};
+    while (!std::filesystem::is_directory(dir, error) &&
+           dir.has_relative_path()) {
+      name = dir.filename();
+      dir = dir.parent_path();
+      missing_dirs_ = true;
+    }
+
+    const int wd{inotify_add_watch(
+        inotify_fd_, dir.c_str(),
+        IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)};
+    if (wd < 0) {
+      spdlog::warn("Not watching {} for changes, restart to apply them: {}",
+                   path->string(), std::system_category().message(errno));
+      continue;
+    }
+    watched_.emplace_back(wd, name.string());
+  }
+}
+
+void Config::OnEvents() {
+  alignas(inotify_event) std::array<char, 4096> buffer{};
+  bool changed{false};
+  bool rewatch{false};
+
+  for (ssize_t length{}; (length = read(inotify_fd_, buffer.data(),
+                                        buffer.size())) > 0;) {
+    for (std::size_t offset{0}; offset < static_cast<std::size_t>(length);) {
+      const auto* const event{
+          reinterpret_cast<const inotify_event*>(buffer.data() + offset)};
+      offset += sizeof(inotify_event) + event->len;
+
+      // Events were lost: assume the files changed.
+      if ((event->mask & IN_Q_OVERFLOW) != 0) {
+        changed = true;
+        continue;
+      }
+      // A watched directory was deleted: watch its ancestor until it is back.
+      if ((event->mask & IN_IGNORED) != 0 &&
+          std::ranges::contains(watched_, event->wd,
+                                &std::pair<int, std::string>::first)) {
+        changed = true;
+        rewatch = true;
+        continue;
+      }
+      if (event->len == 0) {
+        continue;
+      }
+      const std::string_view name{event->name};
+      if (std::ranges::any_of(watched_, [event, name](const auto& watched) {
+            return watched.first == event->wd && watched.second == name;
+          })) {
+        changed = true;
+        // A missing directory appeared: the files may be created in it.
+        rewatch = rewatch || missing_dirs_;
+      }
+    }
+  }
+
+  if (rewatch) {
+    AddWatches();
+  }
+
+  if (changed && !reload_timer_) {
+    reload_timer_ = loop_->AddTimer(kSettleDelay, [this] {
+      Reload();
+      spdlog::info("Reloaded configuration");
+    });
+  }
+}
+
+}  // namespace config
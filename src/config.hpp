@@ -0,0 +1,146 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Runtime configuration, from a file reloaded when it changes.
+
+#ifndef UDISKEN_CONFIG_HPP_
+#define UDISKEN_CONFIG_HPP_
+
+#include "loop.hpp"
+#include "options.hpp"
+#include "policy.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Runtime configuration, read from a file and reloaded when it changes.
+///
+/// The config file holds one setting per line:
+///
+///     # Send desktop notifications.
+///     notify = true
+///     # Group notifications of a drive's mounts within this many ms.
+///     notify-window = 500
+///
+/// The automount policy is read from its own rule file; see policy::Policy.
+namespace config {
+
+/// Settings in effect, never modified: a reload replaces them as a whole.
+struct Snapshot {
+  options::Options options{};
+  policy::Policy policy{};
+};
+
+/// Settings given on the command line or by the environment, which take
+/// precedence over the config file.
+struct Overrides {
+  std::optional<bool> notify{};
+  std::optional<std::chrono::milliseconds> notify_window{};
+};
+
+/// Parse a config file's contents into options. Invalid lines are logged and
+/// skipped.
+///
+/// @param text Contents of the config file.
+/// @param source Where the contents come from, such as a file path, for logs.
+options::Options ParseOptions(std::string_view text, std::string_view source);
+
+/// Configuration of UDISKEN: the config file, and the automount policy.
+///
+/// Both files are read once into a snapshot, and read again when they change,
+/// replacing the snapshot. Reading the settings costs a single pointer load.
+class Config {
+ public:
+  /// Load the config and policy files, and watch them for changes.
+  ///
+  /// @param loop Loop watching the files; nullptr to never reload them.
+  /// @param config_path Path to the config file; defaults apply if it does
+  /// not exist.
+  /// @param policy_path Path to the policy rule file; there are no rules if it
+  /// does not exist.
+  /// @param overrides Settings overriding those of the config file.
+  Config(loop::MainLoop* loop, std::filesystem::path config_path,
+         std::filesystem::path policy_path, Overrides overrides);
+
+  Config(const Config&) = delete;
+  Config(Config&&) = delete;
+  Config& operator=(const Config&) = delete;
+  Config& operator=(Config&&) = delete;
+
+  /// Stops watching the files.
+  ~Config() noexcept;
+
+  /// Settings in effect.
+  ///
+  /// @return Snapshot, valid until the next reload. Reloads happen on the
+  /// loop's thread: do not keep the reference across a suspension point, nor
+  /// use it off the loop's thread.
+  const Snapshot& Get() const {
+    return *current_.load(std::memory_order_acquire);
+  }
+
+  /// Default config file: $XDG_CONFIG_HOME/udisken/config, or
+  /// ~/.config/udisken/config.
+  static std::filesystem::path DefaultPath();
+
+ private:
+  /// Read both files into a new snapshot, and swap it in.
+  void Reload();
+  /// Watch the directories of the files with inotify.
+  void Watch();
+  /// Replace the inotify watches: on the directory of each file or, while it
+  /// does not exist, on its nearest existing ancestor, for the creation of
+  /// the next directory down.
+  void AddWatches();
+  /// Handle inotify events, reloading soon if a watched file changed.
+  void OnEvents();
+
+  loop::MainLoop* loop_;
+  std::filesystem::path config_path_;
+  std::filesystem::path policy_path_;
+  Overrides overrides_;
+
+  /// Owns the snapshot in effect.
+  std::unique_ptr<const Snapshot> snapshot_{};
+  /// Snapshot in effect, read by Get.
+  std::atomic<const Snapshot*> current_{};
+
+  int inotify_fd_{-1};
+  /// Watch descriptors, with the name of the file, or missing directory,
+  /// watched in the directory.
+  std::vector<std::pair<int, std::string>> watched_{};
+  /// A directory of the files is missing: watches are replaced once a watched
+  /// name appears.
+  bool missing_dirs_{};
+  std::optional<loop::SourceId> watch_{};
+  /// Timer reloading, once the files settle after a change.
+  std::optional<loop::SourceId> reload_timer_{};
+};
+
+}  // namespace config
+
+#endif  // UDISKEN_CONFIG_HPP_
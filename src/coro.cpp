@@ -0,0 +1,110 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Coroutines running on the event loop, awaiting D-Bus replies and timers.
+
+#include "coro.hpp"
+
+#include "loop.hpp"
+#include "trace.hpp"
+
+#include <sdbus-c++/Error.h>
+#include <sdbus-c++/IProxy.h>
+#include <sdbus-c++/Message.h>
+#include <sdbus-c++/Types.h>
+#include <spdlog/spdlog.h>
+
+#include <coroutine>
+#include <exception>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace coro {
+
+namespace detail {
+
+void LogUnhandled(std::exception_ptr exception) noexcept {
+  try {
+    std::rethrow_exception(std::move(exception));
+  } catch (const std::exception& e) {
+    spdlog::error("Unhandled error in task: {}", e.what());
+  } catch (...) {
+    spdlog::error("Unhandled error in task");
+  }
+}
+
+}  // namespace detail
+
+MethodCall::~MethodCall() noexcept {
+  // Not once replied: the reply handler may be what is destroying us.
+  if (!result_ && pending_.isPending()) {
+    pending_.cancel();
+  }
+}
+
+void MethodCall::await_suspend(std::coroutine_handle<> handle) {
+  pending_ = proxy_->callMethodAsync(
+      call_, [this, handle](sdbus::MethodReply reply,
+                            std::optional<sdbus::Error> error) {
+        if (error) {
+          result_.emplace(std::unexpect, std::move(*error));
+        } else {
+          result_.emplace(std::move(reply));
+        }
+        handle.resume();
+      });
+}
+
+Sleep::~Sleep() noexcept {
+  if (timer_) {
+    loop_->Remove(*timer_);
+  }
+}
+
+void Sleep::await_suspend(std::coroutine_handle<> handle) {
+  timer_ = loop_->AddTimer(delay_, [this, handle] {
+    timer_.reset();
+    handle.resume();
+  });
+}
+
+auto GetProperty(sdbus::IProxy& proxy, std::string_view interface,
+                 std::string_view property)
+    -> Task<std::expected<sdbus::Variant, sdbus::Error>> {
+  const trace::Span span{"Get", proxy.getObjectPath()};
+  auto call{proxy.createMethodCall(
+      sdbus::InterfaceName{"org.freedesktop.DBus.Properties"},
+      sdbus::MethodName{"Get"})};
+  call << std::string{interface} << std::string{property};
+
+  auto reply{co_await MethodCall{proxy, std::move(call)}};
+  if (!reply) {
+    co_return std::unexpected{std::move(reply.error())};
+  }
+
+  sdbus::Variant value{};
+  *reply >> value;
+  co_return value;
+}
+
+}  // namespace coro
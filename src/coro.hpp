@@ -0,0 +1,246 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Coroutines running on the event loop, awaiting D-Bus replies and timers.
+
+#ifndef UDISKEN_CORO_HPP_
+#define UDISKEN_CORO_HPP_
+
+#include "loop.hpp"
+
+#include <sdbus-c++/Error.h>
+#include <sdbus-c++/IProxy.h>
+#include <sdbus-c++/Message.h>
+#include <sdbus-c++/Types.h>
+
+#include <coroutine>
+#include <exception>
+#include <expected>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/// Coroutines running on the event loop, awaiting D-Bus replies and timers.
+///
+/// A coroutine is written as straight code, co_awaiting asynchronous
+/// operations; the loop thread never blocks while it waits. Coroutines are
+/// cancelled by destroying their Task: the operation they are waiting on is
+/// cancelled too, and the coroutine never resumes.
+namespace coro {
+
+namespace detail {
+
+/// Log an exception which escaped a task nobody awaits.
+void LogUnhandled(std::exception_ptr exception) noexcept;
+
+struct PromiseBase {
+  /// Coroutine awaiting this one, resumed once it finishes.
+  std::coroutine_handle<> continuation{};
+  std::exception_ptr exception{};
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <class Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) const noexcept {
+      auto& promise{handle.promise()};
+      if (promise.continuation) {
+        return promise.continuation;
+      }
+      if (promise.exception) {
+        LogUnhandled(promise.exception);
+      }
+
+      return std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  /// Tasks start when started or awaited, not when called.
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  /// Kept suspended once done, until the task is destroyed.
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept {
+    exception = std::current_exception();
+  }
+};
+
+template <class T>
+struct Promise : PromiseBase {
+  std::optional<T> value{};
+
+  void return_value(T result) { value = std::move(result); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+  void return_void() const noexcept {}
+};
+
+}  // namespace detail
+
+/// Coroutine running on the event loop, optionally producing a value.
+///
+/// Owns the coroutine: destroying the task cancels it, along with the tasks
+/// and operations it is awaiting. A task either is awaited by another
+/// coroutine, or started by Start.
+template <class T = void>
+class [[nodiscard]] Task {
+ public:
+  struct promise_type : detail::Promise<T> {
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+  };
+
+  /// Task without coroutine, never running.
+  Task() = default;
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  Task(Task&& other) noexcept
+      : handle_{std::exchange(other.handle_, nullptr)} {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+
+    return *this;
+  }
+
+  ~Task() noexcept { Reset(); }
+
+  /// Run the coroutine until it first waits. It is then resumed by the
+  /// event loop. Must be called from the loop thread, once.
+  void Start() { handle_.resume(); }
+
+  /// The coroutine was started and did not finish yet.
+  bool Running() const { return handle_ && !handle_.done(); }
+
+  bool await_ready() const noexcept { return false; }
+
+  std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation = awaiting;
+
+    return handle_;
+  }
+
+  T await_resume() {
+    auto& promise{handle_.promise()};
+    if (promise.exception) {
+      std::rethrow_exception(promise.exception);
+    }
+    if constexpr (!std::is_void_v<T>) {
+      return std::move(*promise.value);
+    }
+  }
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle_{handle} {}
+
+  void Reset() noexcept {
+    if (handle_) {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  std::coroutine_handle<promise_type> handle_{};
+};
+
+/// Reply to a method call, or the error it failed with.
+using MethodResult = std::expected<sdbus::MethodReply, sdbus::Error>;
+
+/// Awaitable calling a D-Bus method asynchronously, resuming with its reply.
+///
+/// Destroying the awaiting coroutine cancels the call.
+class MethodCall {
+ public:
+  /// @param proxy Proxy to call the method on; must outlive the call.
+  /// @param call Method call, with its arguments.
+  MethodCall(sdbus::IProxy& proxy, sdbus::MethodCall call)
+      : proxy_{&proxy}, call_{std::move(call)} {}
+
+  MethodCall(const MethodCall&) = delete;
+  MethodCall(MethodCall&&) = delete;
+  MethodCall& operator=(const MethodCall&) = delete;
+  MethodCall& operator=(MethodCall&&) = delete;
+
+  ~MethodCall() noexcept;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle);
+  MethodResult await_resume() { return std::move(*result_); }
+
+ private:
+  sdbus::IProxy* proxy_;
+  sdbus::MethodCall call_;
+  sdbus::PendingAsyncCall pending_{};
+  std::optional<MethodResult> result_{};
+};
+
+/// Awaitable resuming after a delay, on the event loop.
+///
+/// Destroying the awaiting coroutine cancels the timer.
+class Sleep {
+ public:
+  /// @param loop Loop running the timer; must outlive the sleep.
+  Sleep(loop::MainLoop& loop, loop::Clock::duration delay)
+      : loop_{&loop}, delay_{delay} {}
+
+  Sleep(const Sleep&) = delete;
+  Sleep(Sleep&&) = delete;
+  Sleep& operator=(const Sleep&) = delete;
+  Sleep& operator=(Sleep&&) = delete;
+
+  ~Sleep() noexcept;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle);
+  void await_resume() const noexcept {}
+
+ private:
+  loop::MainLoop* loop_;
+  loop::Clock::duration delay_;
+  /// Timer resuming the coroutine, until it fired.
+  std::optional<loop::SourceId> timer_{};
+};
+
+/// Get a property of a D-Bus object asynchronously.
+///
+/// @param proxy Proxy to the object; must outlive the task.
+/// @param interface Interface the property belongs to.
+/// @param property Name of the property.
+///
+/// @return Value of the property, or the error getting it failed with.
+auto GetProperty(sdbus::IProxy& proxy, std::string_view interface,
+                 std::string_view property)
+    -> Task<std::expected<sdbus::Variant, sdbus::Error>>;
+
+}  // namespace coro
+
+#endif  // UDISKEN_CORO_HPP_
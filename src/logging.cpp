@@ -0,0 +1,269 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Logging backend: asynchronous, and writing to the systemd journal with
+/// fields identifying the device a record is about.
+
+#include "logging.hpp"
+
+#include "options.hpp"
+
+#include <spdlog/async.h>
+#include <spdlog/async_logger.h>
+#include <spdlog/common.h>
+#include <spdlog/details/log_msg.h>
+#include <spdlog/pattern_formatter.h>
+#include <spdlog/sinks/base_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace logging {
+
+namespace {
+
+/// Records pending for the background thread, before the oldest ones get
+/// dropped.
+constexpr std::size_t kQueueSize{8192};
+
+/// Separates the message from the fields, and the fields from each other.
+/// Not expected in messages, paths nor filesystem types.
+constexpr char kFieldSeparator{'\x1f'};
+
+constexpr auto kJournalSocket{"/run/systemd/journal/socket"};
+
+/// Message of a record, without its fields.
+std::string_view Message(const spdlog::details::log_msg& msg) {
+  const std::string_view payload{msg.payload.data(), msg.payload.size()};
+
+  return payload.substr(0, payload.find(kFieldSeparator));
+}
+
+/// Prints the message of a record without its fields, in place of spdlog's
+/// %v flag.
+class MessageFlag final : public spdlog::custom_flag_formatter {
+ public:
+  void format(const spdlog::details::log_msg& msg, const std::tm& /*tm*/,
+              spdlog::memory_buf_t& dest) override {
+    const auto message{Message(msg)};
+    dest.append(message.data(), message.data() + message.size());
+  }
+
+  std::unique_ptr<custom_flag_formatter> clone() const override {
+    return std::make_unique<MessageFlag>();
+  }
+};
+
+/// Whether stderr is connected to the journal, following
+/// systemd.exec(5): $JOURNAL_STREAM holds its device and inode numbers.
+bool StderrIsJournal() {
+  const char* const stream{std::getenv("JOURNAL_STREAM")};
+  if (stream == nullptr) {
+    return false;
+  }
+
+  const std::string_view sv{stream};
+  const auto colon{sv.find(':')};
+  if (colon == std::string_view::npos) {
+    return false;
+  }
+  std::uintmax_t dev{};
+  std::uintmax_t ino{};
+  const auto dev_sv{sv.substr(0, colon)};
+  const auto ino_sv{sv.substr(colon + 1)};
+  if (std::from_chars(dev_sv.data(), dev_sv.data() + dev_sv.size(), dev).ec !=
+          std::errc{} ||
+      std::from_chars(ino_sv.data(), ino_sv.data() + ino_sv.size(), ino).ec !=
+          std::errc{}) {
+    return false;
+  }
+
+  struct stat st{};
+  return fstat(STDERR_FILENO, &st) == 0 && st.st_dev == dev &&
+         st.st_ino == ino;
+}
+
+/// Socket connected to the journal; -1 if it cannot be.
+int ConnectJournal() {
+  const int fd{socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)};
+  if (fd < 0) {
+    return -1;
+  }
+
+  sockaddr_un addr{.sun_family = AF_UNIX, .sun_path{}};
+  std::strncpy(addr.sun_path, kJournalSocket, sizeof(addr.sun_path) - 1);
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) <
+      0) {
+    close(fd);
+
+    return -1;
+  }
+
+  return fd;
+}
+
+/// syslog(3) priority of a level, as the journal expects it.
+char Priority(spdlog::level::level_enum level) {
+  switch (level) {
+    case spdlog::level::critical:
+      return '2';
+    case spdlog::level::err:
+      return '3';
+    case spdlog::level::warn:
+      return '4';
+    case spdlog::level::info:
+      return '6';
+    default:
+      return '7';
+  }
+}
+
+/// Sends records to the journal over its native protocol, with their fields;
+/// see systemd-journald.service(8).
+///
+/// Only used by the background thread, which may block on the journal.
+class JournalSink final : public spdlog::sinks::base_sink<std::mutex> {
+ public:
+  /// @param fd Socket connected to the journal, then owned by the sink.
+  explicit JournalSink(int fd) : fd_{fd} {}
+
+  JournalSink(const JournalSink&) = delete;
+  JournalSink(JournalSink&&) = delete;
+  JournalSink& operator=(const JournalSink&) = delete;
+  JournalSink& operator=(JournalSink&&) = delete;
+
+  ~JournalSink() noexcept override { close(fd_); }
+
+ protected:
+  void sink_it_(const spdlog::details::log_msg& msg) override {
+    datagram_.clear();
+    const char priority{Priority(msg.level)};
+    AppendField("PRIORITY", std::string_view{&priority, 1});
+    AppendField("SYSLOG_IDENTIFIER", globals::kAppName);
+    AppendField("MESSAGE", Message(msg));
+    if (!msg.source.empty()) {
+      AppendField("CODE_FILE", msg.source.filename);
+      AppendField("CODE_LINE", std::to_string(msg.source.line));
+      if (msg.source.funcname != nullptr) {
+        AppendField("CODE_FUNC", msg.source.funcname);
+      }
+    }
+
+    // Fields are attached as NAME=value.
+    std::string_view fields{msg.payload.data(), msg.payload.size()};
+    fields.remove_prefix(Message(msg).size());
+    while (!fields.empty()) {
+      fields.remove_prefix(1);
+      const auto field{fields.substr(0, fields.find(kFieldSeparator))};
+      fields.remove_prefix(field.size());
+      if (const auto equal{field.find('=')}; equal != std::string_view::npos) {
+        AppendField(field.substr(0, equal), field.substr(equal + 1));
+      }
+    }
+
+    // Records are dropped when the journal is gone, rather than thrown
+    // about.
+    [[maybe_unused]] const auto sent{
+        send(fd_, datagram_.data(), datagram_.size(), MSG_NOSIGNAL)};
+  }
+
+  void flush_() override {}
+
+ private:
+  /// Appends a field in the binary form, which allows any value, such as
+  /// messages with newlines.
+  void AppendField(std::string_view name, std::string_view value) {
+    datagram_.append(name);
+    datagram_.push_back('\n');
+    std::uint64_t size{value.size()};
+    for (int byte{}; byte < 8; ++byte, size >>= 8U) {
+      datagram_.push_back(static_cast<char>(size & 0xFFU));
+    }
+    datagram_.append(value);
+    datagram_.push_back('\n');
+  }
+
+  int fd_{};
+  /// Reused between records.
+  std::string datagram_{};
+};
+
+}  // namespace
+
+Backend::Backend(bool timestamps) {
+  spdlog::sink_ptr sink{};
+  if (StderrIsJournal()) {
+    if (const int fd{ConnectJournal()}; fd >= 0) {
+      sink = std::make_shared<JournalSink>(fd);
+      journal_ = true;
+    }
+  }
+  if (!sink) {
+    auto formatter{std::make_unique<spdlog::pattern_formatter>()};
+    formatter->add_flag<MessageFlag>('v').set_pattern(
+        timestamps ? "[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] %v" : "[%^%l%$] %v");
+    sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+    sink->set_formatter(std::move(formatter));
+  }
+
+  spdlog::init_thread_pool(kQueueSize, 1);
+  auto logger{std::make_shared<spdlog::async_logger>(
+      globals::kAppName, std::move(sink), spdlog::thread_pool(),
+      spdlog::async_overflow_policy::overrun_oldest)};
+  logger->set_level(spdlog::get_level());
+  spdlog::set_default_logger(std::move(logger));
+}
+
+// Joins the background thread once it wrote what was pending. Nothing may be
+// logged afterwards: the default logger is gone too.
+Backend::~Backend() noexcept { spdlog::shutdown(); }
+
+void Attach(std::string& message, const Fields& fields) {
+  const auto attach{[&message](std::string_view name, std::string_view value) {
+    if (!value.empty()) {
+      message.push_back(kFieldSeparator);
+      message.append(name);
+      message.push_back('=');
+      message.append(value);
+    }
+  }};
+
+  attach("OBJECT_PATH", fields.object_path);
+  attach("MOUNT_POINT", fields.mount_point);
+  attach("FSTYPE", fields.fstype);
+}
+
+}  // namespace logging
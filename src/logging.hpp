@@ -0,0 +1,142 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Logging backend: asynchronous, and writing to the systemd journal with
+/// fields identifying the device a record is about.
+
+#ifndef UDISKEN_LOGGING_HPP_
+#define UDISKEN_LOGGING_HPP_
+
+#include <spdlog/common.h>
+#include <spdlog/spdlog.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+/// Logging backend: asynchronous, and writing to the systemd journal with
+/// fields identifying the device a record is about.
+namespace logging {
+
+/// Journal fields of a record, so that the journal can be filtered by device
+/// without regular expressions, such as with
+/// journalctl OBJECT_PATH=/org/freedesktop/UDisks2/block_devices/sdb1.
+///
+/// Empty fields are left out.
+struct Fields {
+  /// UDisks object path of the block device.
+  std::string_view object_path{};
+  /// Where the filesystem got mounted.
+  std::string_view mount_point{};
+  /// Filesystem type, such as vfat.
+  std::string_view fstype{};
+};
+
+/// Replaces the default logger for as long as it lives.
+///
+/// Records are formatted by the calling thread, then written by a background
+/// one, so that slow terminals or journals never hold up signal dispatch.
+/// When more records are pending than the bounded queue holds, the oldest
+/// ones are dropped rather than blocking.
+///
+/// Records go to the journal when stderr is connected to it, as it is under
+/// systemd; otherwise they go to stdout.
+///
+/// As a background thread is started, construct it after blocking signals
+/// (see loop::MainLoop::QuitOnSignals).
+class Backend {
+ public:
+  /// @param timestamps Display timestamps on stdout; the journal keeps its
+  /// own.
+  explicit Backend(bool timestamps);
+
+  Backend(const Backend&) = delete;
+  Backend(Backend&&) = delete;
+  Backend& operator=(const Backend&) = delete;
+  Backend& operator=(Backend&&) = delete;
+
+  /// Writes pending records, and stops the background thread.
+  ~Backend() noexcept;
+
+  /// Whether records go to the journal.
+  bool Journal() const { return journal_; }
+
+ private:
+  bool journal_{};
+};
+
+/// Appends the fields to the message, for the sinks to recover.
+///
+/// @param message Formatted message.
+void Attach(std::string& message, const Fields& fields);
+
+/// Logs a record with journal fields.
+///
+/// Prefer the SPDLOG_DEBUG macro or Debug for debug records, which are
+/// compiled out of release builds.
+template <class... Args>
+void Log(spdlog::level::level_enum level, const Fields& fields,
+         spdlog::format_string_t<Args...> fmt, Args&&... args) {
+  auto* const logger{spdlog::default_logger_raw()};
+  if (!logger->should_log(level)) {
+    return;
+  }
+
+  std::string message{
+      spdlog::fmt_lib::format(fmt, std::forward<Args>(args)...)};
+  Attach(message, fields);
+  logger->log(level, spdlog::string_view_t{message});
+}
+
+/// Logs a debug record with journal fields, unless compiled out (see
+/// SPDLOG_ACTIVE_LEVEL).
+template <class... Args>
+void Debug([[maybe_unused]] const Fields& fields,
+           [[maybe_unused]] spdlog::format_string_t<Args...> fmt,
+           [[maybe_unused]] Args&&... args) {
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+  Log(spdlog::level::debug, fields, fmt, std::forward<Args>(args)...);
+#endif
+}
+
+/// Logs an informational record with journal fields.
+template <class... Args>
+void Info(const Fields& fields, spdlog::format_string_t<Args...> fmt,
+          Args&&... args) {
+  Log(spdlog::level::info, fields, fmt, std::forward<Args>(args)...);
+}
+
+/// Logs a warning with journal fields.
+template <class... Args>
+void Warn(const Fields& fields, spdlog::format_string_t<Args...> fmt,
+          Args&&... args) {
+  Log(spdlog::level::warn, fields, fmt, std::forward<Args>(args)...);
+}
+
+/// Logs an error with journal fields.
+template <class... Args>
+void Error(const Fields& fields, spdlog::format_string_t<Args...> fmt,
+           Args&&... args) {
+  Log(spdlog::level::err, fields, fmt, std::forward<Args>(args)...);
+}
+
+}  // namespace logging
+
+#endif  // UDISKEN_LOGGING_HPP_
@@ -0,0 +1,324 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Main event loop, dispatching D-Bus messages, timers and file descriptor
+/// events on one thread.
+
+#include "loop.hpp"
+
+#include <sdbus-c++/IConnection.h>
+#include <signal.h>
+#include <spdlog/spdlog.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace loop {
+
+namespace {
+
+// Sources owned by the loop itself; IDs of timers and watches start after
+// them.
+constexpr SourceId kTimerSource{1};
+constexpr SourceId kWakeupSource{2};
+constexpr SourceId kSignalSource{3};
+/// Shared by all connections, which are all processed on each iteration.
+constexpr SourceId kConnectionSource{4};
+constexpr SourceId kFirstUserSource{16};
+
+[[noreturn]] void ThrowErrno(const char* what) {
+  throw std::system_error{errno, std::generic_category(), what};
+}
+
+void EpollAdd(int epoll_fd, int fd, std::uint32_t events, SourceId id) {
+  epoll_event event{.events = events, .data{.u64 = id}};
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    ThrowErrno("could not watch file descriptor");
+  }
+}
+
+/// Read and discard the counter of an eventfd, timerfd or similar.
+void Drain(int fd) {
+  std::uint64_t count{};
+  [[maybe_unused]] const auto read_size{read(fd, &count, sizeof(count))};
+}
+
+}  // namespace
+
+MainLoop::MainLoop()
+    : epoll_fd_{epoll_create1(EPOLL_CLOEXEC)},
+      timer_fd_{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)},
+      wakeup_fd_{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+      next_id_{kFirstUserSource} {
+  if (epoll_fd_ < 0 || timer_fd_ < 0 || wakeup_fd_ < 0) {
+    const int err{errno};
+    for (const int fd : {epoll_fd_, timer_fd_, wakeup_fd_}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+    throw std::system_error{err, std::generic_category(),
+                            "could not create event loop"};
+  }
+
+  EpollAdd(epoll_fd_, timer_fd_, EPOLLIN, kTimerSource);
+  EpollAdd(epoll_fd_, wakeup_fd_, EPOLLIN, kWakeupSource);
+}
+
+MainLoop::~MainLoop() noexcept {
+  if (signal_fd_ >= 0) {
+    close(signal_fd_);
+  }
+  close(wakeup_fd_);
+  close(timer_fd_);
+  close(epoll_fd_);
+}
+
+void MainLoop::AddConnection(sdbus::IConnection& connection) {
+  const auto poll_data{connection.getEventLoopPollData()};
+  const auto events{
+      static_cast<std::uint32_t>(static_cast<std::uint16_t>(poll_data.events))};
+
+  // poll and epoll event flags share their values.
+  EpollAdd(epoll_fd_, poll_data.fd, events, kConnectionSource);
+  // Readable when messages were queued from another thread.
+  EpollAdd(epoll_fd_, poll_data.eventFd, EPOLLIN, kConnectionSource);
+
+  connections_.push_back(Connection{
+      .connection = &connection, .fd = poll_data.fd, .events = events});
+}
+
+SourceId MainLoop::Watch(int fd, std::uint32_t events, WatchCallback callback) {
+  const SourceId id{next_id_++};
+  EpollAdd(epoll_fd_, fd, events, id);
+  watches_.emplace(id, FdWatch{.fd = fd, .callback = std::move(callback)});
+
+  return id;
+}
+
+SourceId MainLoop::AddTimer(Clock::duration delay, Callback callback) {
+  const SourceId id{next_id_++};
+  const auto timer{timers_.emplace(
+      Clock::now() + delay, Timer{.id = id, .callback = std::move(callback)})};
+  if (timer == timers_.begin()) {
+    ArmTimerFd();
+  }
+
+  return id;
+}
+
+void MainLoop::Remove(SourceId id) {
+  if (const auto watch{watches_.find(id)}; watch != watches_.end()) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, watch->second.fd, nullptr);
+    watches_.erase(watch);
+
+    return;
+  }
+
+  // Few timers are pending at once: a linear search is enough.
+  for (auto timer{timers_.begin()}; timer != timers_.end(); ++timer) {
+    if (timer->second.id == id) {
+      const bool earliest{timer == timers_.begin()};
+      timers_.erase(timer);
+      if (earliest) {
+        ArmTimerFd();
+      }
+
+      return;
+    }
+  }
+}
+
+void MainLoop::Defer(Callback callback) {
+  deferred_.Push(std::move(callback));
+
+  const std::uint64_t one{1};
+  [[maybe_unused]] const auto write_size{write(wakeup_fd_, &one, sizeof(one))};
+}
+
+void MainLoop::QuitOnSignals(std::initializer_list<int> signals) {
+  sigset_t mask{};
+  sigemptyset(&mask);
+  for (const int signo : signals) {
+    sigaddset(&mask, signo);
+  }
+  pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+  signal_fd_ = signalfd(signal_fd_, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signal_fd_ < 0) {
+    ThrowErrno("could not create signalfd");
+  }
+  epoll_event event{.events = EPOLLIN, .data{.u64 = kSignalSource}};
+  // Already added if signals were given before.
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, signal_fd_, &event) < 0 &&
+      errno != EEXIST) {
+    ThrowErrno("could not watch signalfd");
+  }
+}
+
+void MainLoop::Run() {
+  running_ = true;
+
+  std::array<epoll_event, 16> events{};
+  while (running_) {
+    // Deferred work may send messages: run it before the connections are
+    // flushed and polled.
+    RunDeferred();
+    const int timeout{ProcessConnections()};
+    if (!running_) {
+      break;
+    }
+
+    const int count{epoll_wait(epoll_fd_, events.data(),
+                               static_cast<int>(events.size()), timeout)};
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ThrowErrno("epoll_wait failed");
+    }
+
+    for (const auto& event :
+         std::span{events}.first(static_cast<std::size_t>(count))) {
+      Dispatch(event.data.u64, event.events);
+    }
+  }
+}
+
+void MainLoop::Quit() {
+  running_ = false;
+
+  const std::uint64_t one{1};
+  [[maybe_unused]] const auto write_size{write(wakeup_fd_, &one, sizeof(one))};
+}
+
+int MainLoop::ProcessConnections() {
+  int timeout{-1};
+
+  for (auto& conn : connections_) {
+    while (conn.connection->processPendingEvent()) {
+    }
+
+    const auto poll_data{conn.connection->getEventLoopPollData()};
+    const auto events{static_cast<std::uint32_t>(
+        static_cast<std::uint16_t>(poll_data.events))};
+    // Only pay for epoll_ctl when the connection starts or stops waiting to
+    // write.
+    if (events != conn.events) {
+      epoll_event event{.events = events, .data{.u64 = kConnectionSource}};
+      epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &event);
+      conn.events = events;
+    }
+
+    if (const int conn_timeout{poll_data.getPollTimeout()};
+        conn_timeout >= 0 && (timeout < 0 || conn_timeout < timeout)) {
+      timeout = conn_timeout;
+    }
+  }
+
+  return timeout;
+}
+
+void MainLoop::RunDeferred() {
+  // Work deferred by the callbacks themselves also runs now.
+  while (auto callback{deferred_.Pop()}) {
+    (*callback)();
+  }
+}
+
+void MainLoop::RunTimers() {
+  Drain(timer_fd_);
+
+  const auto now{Clock::now()};
+  while (!timers_.empty() && timers_.begin()->first <= now) {
+    // Extracted before calling: the callback may add or remove timers.
+    auto timer{timers_.extract(timers_.begin())};
+    timer.mapped().callback();
+  }
+
+  ArmTimerFd();
+}
+
+void MainLoop::ArmTimerFd() {
+  itimerspec spec{};
+  if (!timers_.empty()) {
+    // steady_clock is CLOCK_MONOTONIC on Linux.
+    const auto deadline{timers_.begin()->first.time_since_epoch()};
+    const auto secs{std::chrono::floor<std::chrono::seconds>(deadline)};
+    spec.it_value.tv_sec = secs.count();
+    spec.it_value.tv_nsec = std::chrono::nanoseconds{deadline - secs}.count();
+    // A zero value would disarm the timer instead.
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+      spec.it_value.tv_nsec = 1;
+    }
+  }
+
+  timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void MainLoop::Dispatch(SourceId id, std::uint32_t events) {
+  switch (id) {
+    case kTimerSource:
+      RunTimers();
+      return;
+    case kWakeupSource:
+      // Deferred work runs at the start of the next iteration.
+      Drain(wakeup_fd_);
+      return;
+    case kSignalSource: {
+      signalfd_siginfo info{};
+      if (read(signal_fd_, &info, sizeof(info)) == sizeof(info)) {
+        spdlog::info("Received signal {}, quitting", info.ssi_signo);
+        Quit();
+      }
+      return;
+    }
+    case kConnectionSource:
+      // Connections are processed at the start of the next iteration.
+      return;
+    default:
+      break;
+  }
+
+  const auto watch{watches_.find(id)};
+  // Removed by a callback earlier in this iteration.
+  if (watch == watches_.end()) {
+    return;
+  }
+  // Copied: the callback may remove its own watch.
+  const WatchCallback callback{watch->second.callback};
+  callback(events);
+}
+
+}  // namespace loop
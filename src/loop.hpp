@@ -0,0 +1,171 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Main event loop, dispatching D-Bus messages, timers and file descriptor
+/// events on one thread.
+
+#ifndef UDISKEN_LOOP_HPP_
+#define UDISKEN_LOOP_HPP_
+
+#include "queue.hpp"
+
+#include <sdbus-c++/IConnection.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+/// Main event loop, dispatching D-Bus messages, timers and file descriptor
+/// events on one thread.
+namespace loop {
+
+using Clock = std::chrono::steady_clock;
+
+/// Callback function type, for timers and deferred work.
+using Callback = std::function<void()>;
+
+/// Callback function type, for file descriptor watches.
+///
+/// Function returns nothing, and takes the epoll events that occurred (type:
+/// std::uint32_t).
+using WatchCallback = std::function<void(std::uint32_t)>;
+
+/// Identifies a timer or a file descriptor watch.
+using SourceId = std::uint64_t;
+
+/// Event loop built on epoll.
+///
+/// Dispatches messages of sdbus-c++ connections, using their file descriptors
+/// and timeouts, alongside timers (all behind one timerfd), file descriptor
+/// watches, and work deferred from other threads. Sleeps until one of these
+/// needs attention: idling costs no CPU.
+///
+/// Unless stated otherwise, functions must be called from the loop's thread.
+class MainLoop {
+ public:
+  /// @throws std::system_error Could not create the epoll instance, timerfd
+  /// or eventfd.
+  MainLoop();
+
+  MainLoop(const MainLoop&) = delete;
+  MainLoop(MainLoop&&) = delete;
+  MainLoop& operator=(const MainLoop&) = delete;
+  MainLoop& operator=(MainLoop&&) = delete;
+
+  ~MainLoop() noexcept;
+
+  /// Dispatch a connection's messages on this loop.
+  ///
+  /// @param connection Connection, which must outlive the loop, and must not
+  /// run its own event loop.
+  void AddConnection(sdbus::IConnection& connection);
+
+  /// Watch a file descriptor.
+  ///
+  /// @param fd File descriptor; the watch must be removed before closing it.
+  /// @param events Epoll events to watch for, such as EPOLLIN.
+  /// @param callback Called when any of the events occur; level-triggered.
+  ///
+  /// @return ID of the watch, to remove it.
+  SourceId Watch(int fd, std::uint32_t events, WatchCallback callback);
+
+  /// Call a function once, after a delay.
+  ///
+  /// @return ID of the timer, to cancel it.
+  SourceId AddTimer(Clock::duration delay, Callback callback);
+
+  /// Remove a file descriptor watch, or cancel a timer. Does nothing if the
+  /// watch was already removed, or the timer already fired.
+  void Remove(SourceId id);
+
+  /// Call a function on the loop's thread, as soon as possible.
+  /// Can be called from any thread, and never blocks: this is how other
+  /// threads hand their results back to the loop.
+  void Defer(Callback callback);
+
+  /// Quit the loop when receiving one of these signals, instead of being
+  /// terminated by them. Blocks the signals in the calling thread, so this
+  /// should be called before starting other threads.
+  ///
+  /// @throws std::system_error Could not create the signalfd.
+  void QuitOnSignals(std::initializer_list<int> signals);
+
+  /// Dispatch events until Quit is called.
+  void Run();
+
+  /// Make Run return, once the current event is dispatched.
+  /// Can be called from any thread.
+  void Quit();
+
+ private:
+  struct Connection {
+    sdbus::IConnection* connection;
+    int fd;
+    /// Epoll events currently watched on fd.
+    std::uint32_t events;
+  };
+
+  struct Timer {
+    SourceId id;
+    Callback callback;
+  };
+
+  struct FdWatch {
+    int fd;
+    WatchCallback callback;
+  };
+
+  /// Process pending messages of all connections, and watch the events they
+  /// now wait for.
+  ///
+  /// @return Timeout before the connections need processing again, in
+  /// milliseconds; -1 if none.
+  int ProcessConnections();
+  void RunDeferred();
+  void RunTimers();
+  /// Arm the timerfd for the earliest timer, or disarm it if there are none.
+  void ArmTimerFd();
+  void Dispatch(SourceId id, std::uint32_t events);
+
+  int epoll_fd_;
+  int timer_fd_;
+  /// Eventfd waking up the loop when work is deferred or Quit called.
+  int wakeup_fd_;
+  int signal_fd_{-1};
+
+  std::atomic<bool> running_{false};
+  SourceId next_id_;
+
+  std::vector<Connection> connections_{};
+  std::unordered_map<SourceId, FdWatch> watches_{};
+  std::multimap<Clock::time_point, Timer> timers_{};
+
+  /// Work deferred from any thread, run in order.
+  queue::MpscQueue<Callback> deferred_{};
+};
+
+}  // namespace loop
+
+#endif  // UDISKEN_LOOP_HPP_
@@ -20,16 +20,44 @@
 
 /// Main entrypoint; initiates connection to D-Bus and UDisks.
 
+#include "config.hpp"
+#include "logging.hpp"
+#include "loop.hpp"
+#include "mount.hpp"
+#include "notify.hpp"
 #include "options.hpp"
+#include "policy.hpp"
+#include "pool.hpp"
+#include "process.hpp"
+#include "record.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 #include "udisks.hpp"
 
 #include <argparse/argparse.hpp>
+#include <sdbus-c++/Error.h>
 #include <sdbus-c++/IConnection.h>
+#include <signal.h>
 #include <spdlog/common.h>
 #include <spdlog/spdlog.h>
+#include <sys/epoll.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+
+namespace {
+
+constexpr unsigned kWorkerThreads{2};
+constexpr std::size_t kMaxPendingWork{64};
+
+}  // namespace
 
 int main(int argc, char* argv[]) {
   argparse::ArgumentParser program{globals::kAppName, globals::kAppVersion};
@@ -43,6 +71,32 @@ int main(int argc, char* argv[]) {
       .help("do not send desktop notifications")
       .flag()
       .store_into(no_notify);
+  int notify_window{};
+  program.add_argument("--notify-window")
+      .help("group notifications of a drive's filesystems mounted within "
+            "this many milliseconds")
+      .default_value(
+          static_cast<int>(options::Options{}.notify_window.count()))
+      .store_into(notify_window);
+  std::string config_path{};
+  program.add_argument("--config")
+      .help("read settings from this file, reloaded when it changes")
+      .default_value(config::Config::DefaultPath().string())
+      .store_into(config_path);
+  std::string policy_path{};
+  program.add_argument("--policy")
+      .help("read automount rules from this file, reloaded when it changes")
+      .default_value(policy::Policy::DefaultPath().string())
+      .store_into(policy_path);
+  std::string trace_path{};
+  program.add_argument("--trace")
+      .help("write what is done for each device to this file, as Chrome "
+            "trace events")
+      .store_into(trace_path);
+  std::string record_path{};
+  program.add_argument("--record")
+      .help("record UDisks traffic to this file, to replay it")
+      .store_into(record_path);
   bool verbose{};
   program.add_argument("-d", "--debug", "--verbose")
       .help("increase output verbosity")
@@ -56,10 +110,14 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
-  if (options::NonZeroEnvVar("UDISKEN_NO_LOG_TIMESTAMP") || no_log_timestamp) {
-    // Enable coloring log level, display log level and normal text only.
-    spdlog::set_pattern("[%^%l%$] %v");
-  }
+  loop::MainLoop main_loop{};
+  // Quit cleanly, unregistering from D-Bus and closing what was opened.
+  main_loop.QuitOnSignals({SIGINT, SIGTERM});
+
+  // Started once signals are blocked, for them to reach the loop only.
+  const logging::Backend logging_backend{
+      !options::NonZeroEnvVar("UDISKEN_NO_LOG_TIMESTAMP") &&
+      !no_log_timestamp};
 
   if (globals::kDebug || options::NonZeroEnvVar("DEBUG") || verbose) {
     spdlog::set_level(spdlog::level::debug);
@@ -68,12 +126,101 @@ int main(int argc, char* argv[]) {
   // Startup message: UDISKEN (version)
   spdlog::info("{} {}", globals::kAppNameUi, globals::kAppVersion);
 
+  if (const char* const env{std::getenv("UDISKEN_TRACE")};
+      trace_path.empty() && env != nullptr) {
+    trace_path = env;
+  }
+  std::unique_ptr<trace::Recorder> trace_recorder{};
+  if (!trace_path.empty()) {
+    try {
+      trace_recorder = std::make_unique<trace::Recorder>(trace_path);
+    } catch (const std::system_error& e) {
+      spdlog::warn("Not tracing: {}", e.what());
+    }
+  }
+
   const auto connection{sdbus::createSystemBusConnection()};
+  main_loop.AddConnection(*connection);
   managers::UdisksManager mgr{*connection};
   spdlog::info("Connected to UDisks version {} on D-Bus", mgr.Version());
-  managers::UdisksObjectManager obj_mgr{*connection,
-                                        options::Options{.notify = !no_notify}};
 
-  spdlog::debug("Entering event loop");
-  connection->enterEventLoop();
+  // Statistics are served on the session bus, from the loop thread, for tools
+  // to read without system bus policies.
+  std::unique_ptr<sdbus::IConnection> stats_connection{};
+  std::unique_ptr<stats::Service> stats_service{};
+  try {
+    stats_connection = sdbus::createSessionBusConnection();
+    stats_service = std::make_unique<stats::Service>(*stats_connection);
+    main_loop.AddConnection(*stats_connection);
+  } catch (const sdbus::Error& e) {
+    spdlog::warn("Statistics unavailable: {}", e.what());
+  }
+
+  // Declared before the notification client, whose own event loop thread
+  // may launch programs when an action is invoked, until it is destroyed.
+  process::Launcher launcher{};
+  main_loop.Watch(launcher.Fd(), EPOLLIN,
+                  [&launcher](std::uint32_t /*events*/) {
+                    launcher.ReapChildren();
+                  });
+
+  // Read once: the environment does not change while running.
+  const bool notify_disabled{no_notify ||
+                             options::NonZeroEnvVar("UDISKEN_NO_NOTIFY")};
+
+  std::unique_ptr<notify::Client> notify_client{};
+  if (!notify_disabled) {
+    try {
+      notify_client = std::make_unique<notify::Client>();
+    } catch (const sdbus::Error& e) {
+      spdlog::warn("Desktop notifications unavailable: {}", e.what());
+    }
+  }
+
+  // The command line and environment take precedence over the config file.
+  config::Overrides overrides{};
+  if (notify_disabled) {
+    overrides.notify = false;
+  }
+  if (program.is_used("--notify-window")) {
+    overrides.notify_window =
+        std::chrono::milliseconds{std::max(notify_window, 0)};
+  }
+  const config::Config config{&main_loop, config_path, policy_path, overrides};
+
+  // Sends notifications, waiting for the notification server off the loop
+  // thread.
+  pool::WorkerPool workers{main_loop, kWorkerThreads, kMaxPendingWork};
+
+  std::unique_ptr<mount::Notifier> notifier{};
+  if (notify_client) {
+    notifier = std::make_unique<mount::Notifier>(
+        *notify_client, &launcher, &main_loop, &workers, &config);
+  }
+
+  if (const char* const env{std::getenv("UDISKEN_RECORD")};
+      record_path.empty() && env != nullptr) {
+    record_path = env;
+  }
+  std::unique_ptr<record::Writer> recorder{};
+  if (!record_path.empty()) {
+    try {
+      recorder = std::make_unique<record::Writer>(record_path);
+      spdlog::info("Recording UDisks traffic to {}", record_path);
+    } catch (const std::system_error& e) {
+      spdlog::warn("Not recording: {}", e.what());
+    }
+  }
+
+  managers::UdisksObjectManager obj_mgr{
+      *connection, mount::Context{.notifier = notifier.get(),
+                                  .loop = &main_loop,
+                                  .config = &config,
+                                  .recorder = recorder.get()}};
+
+  SPDLOG_DEBUG("Entering event loop");
+  main_loop.Run();
+  SPDLOG_DEBUG("Left event loop");
+
+  return EXIT_SUCCESS;
 }
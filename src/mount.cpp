@@ -22,8 +22,16 @@
 
 #include "mount.hpp"
 
+#include "arena.hpp"
+#include "coro.hpp"
+#include "logging.hpp"
 #include "notify.hpp"
-#include "options.hpp"
+#include "policy.hpp"
+#include "process.hpp"
+#include "profiles.hpp"
+#include "record.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 #include "udisks.hpp"
 
 #include <sdbus-c++/Error.h>
@@ -31,27 +39,29 @@
 #include <sdbus-c++/ProxyInterfaces.h>
 #include <sdbus-c++/Types.h>
 #include <spdlog/spdlog.h>
+#include <sys/wait.h>
 #include <udisks-sdbus-cpp/udisks_errors.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
-#include <cstdlib>
+#include <expected>
 #include <format>
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 namespace mount {
 
-namespace {
-
-/// Converts an array of array of bytes (D-Bus equivalent type: a{a{y}})
-/// to a vector of strings.
-///
-/// @param aay The array of array of bytes.
 auto ConvertArrayArrayByte(const std::vector<std::vector<std::uint8_t>>& aay)
     -> std::vector<std::string> {
   return aay | std::views::transform([](const auto& vec) {
@@ -59,9 +69,18 @@ auto ConvertArrayArrayByte(const std::vector<std::vector<std::uint8_t>>& aay)
          }) |
          std::ranges::to<std::vector<std::string>>();
 }
-// TEST: convert sample data.
 
-}  // namespace
+auto ViewArrayArrayByte(const std::vector<std::vector<std::uint8_t>>& aay,
+                        std::pmr::memory_resource* resource)
+    -> std::pmr::vector<std::string_view> {
+  std::pmr::vector<std::string_view> views{resource};
+  views.reserve(aay.size());
+  for (const auto& bytes : aay) {
+    views.push_back(objects::ViewByteString(bytes));
+  }
+
+  return views;
+}
 
 // Seemingly no methods generated by sdbus-c++ are marked
 // const... Can't mark this const.
@@ -69,140 +88,497 @@ MountPoints GetMountPoints(udisks_sd::proxy_wrappers::UdisksFilesystem& fs) {
   return ConvertArrayArrayByte(fs.MountPoints());
 }
 
-void DebugMountPoints(const MountPoints& mnt_points) {
+void DebugMountPoints(std::span<const std::string_view> mnt_points) {
   for (const auto& mnt_point : mnt_points) {
-    spdlog::debug("- {}", mnt_point);
+    SPDLOG_DEBUG("- {}", mnt_point);
   }
 }
 
 namespace {
 
-int OpenPathWithDefaultApp(const std::string& str) {
-  return std::system(std::format("xdg-open file://{}", str).c_str());
-}
-
 bool SystemCommandFailed(int stat_val) {
   return !WIFEXITED(stat_val) || WEXITSTATUS(stat_val) != 0;
 }
 
-void PrintNotAutomounting(const objects::BlockDevice& blk_device,
-                          std::string_view reason) {
-  spdlog::debug("Not automounting {}: {}", blk_device.ObjectPath().c_str(),
-                reason);
+/// Open a path with the default application, without waiting for it to exit.
+///
+/// @param object_path UDisks object path of the device the path is on, or of
+/// its drive.
+void OpenPathWithDefaultApp(process::Launcher& launcher,
+                            const std::string& path,
+                            std::string_view object_path) {
+  const auto launched{launcher.Spawn(
+      {"xdg-open", path},
+      [](int stat_val) {
+        if (SystemCommandFailed(stat_val)) {
+          spdlog::warn(
+              "xdg-open might have failed; check if xdg-utils is installed");
+        }
+      },
+      object_path)};
+  if (!launched) {
+    spdlog::warn("Could not launch xdg-open; check if xdg-utils is installed");
+  }
 }
 
-bool NotifyMounted(udisks_sd::proxy_wrappers::UdisksBlock& blk,
-                   const std::string& mnt_point) {
-  std::string blk_name{};
-  if (!blk.HintName().empty()) {
-    blk_name = blk.HintName();
-  } else if (!blk.IdLabel().empty()) {
-    blk_name = blk.IdLabel();
-  } else {
-    blk_name = "Drive";
-  }  // TODO: also lookup UDisks2.Drive.Model
-     // TODO: To do that, consider storing the interfaces
-     // somewhere and access them (start by reverting e5d18f78b47e).
-  std::string blk_icon_name{blk.HintIconName().empty() ? "drive-removable-media"
-                                                       : blk.HintIconName()};
+/// Log why a block device is not automounted, and count it once per block
+/// device and reason.
+///
+/// @param reason Static string.
+void SkipAutomount(objects::BlockDevice& blk_device, std::string_view reason) {
+  logging::Debug({.object_path = blk_device.ObjectPath()},
+                 "Not automounting {}: {}", blk_device.ObjectPath().c_str(),
+                 reason);
+  if (blk_device.NoteSkip(reason)) {
+    stats::Global().skips.Add(reason);
+  }
+}
 
-  const std::string action_open_fm{"system-file-manager"};
-  const std::string action_open_fm_text{"Open in File Manager"};
+/// Name of a block device, as presented to the user.
+///
+/// @param drive Properties of its drive, if known.
+std::string BlockName(const objects::BlockProperties& blk,
+                      const objects::DriveProperties* drive) {
+  if (!blk.hint_name.empty()) {
+    return blk.hint_name;
+  }
+  if (!blk.id_label.empty()) {
+    return blk.id_label;
+  }
+  if (drive != nullptr && !drive->model.empty()) {
+    return drive->vendor.empty()
+               ? drive->model
+               : std::format("{} {}", drive->vendor, drive->model);
+  }
+
+  return "Drive";
+}
+
+/// Directories of images that package managers mount through loop devices,
+/// such as snaps.
+constexpr std::array<std::string_view, 3> kPackageImageDirs{
+    "/var/lib/snapd/", "/var/lib/flatpak/", "/snap/"};
+
+/// Mounts of a drive arriving this long after its notification was sent
+/// update it; later ones get a new notification.
+constexpr std::chrono::seconds kUpdateWindow{30};
+
+/// Log mount points, as read from the MountPoints property.
+///
+/// sdbus-c++ only reads a variant by copying its value out, so the mount
+/// points are copied to the heap; only the views of that copy are on the
+/// arena. Not part of the coroutine below: the arena lives on the stack,
+/// rather than in the coroutine's frame on the heap.
+void DebugMountPointsProperty(const sdbus::Variant& mnt_points) {
+  using RawMountPoints = std::vector<std::vector<std::uint8_t>>;
+  if (!mnt_points.containsValueOfType<RawMountPoints>()) {
+    return;
+  }
+
+  arena::EventArena arena{};
+  const auto raw{mnt_points.get<RawMountPoints>()};
+  SPDLOG_DEBUG("Current mount points:");
+  DebugMountPoints(ViewArrayArrayByte(raw, arena.Resource()));
+}
+
+/// Log the mount points UDisks currently knows of, as verbose output.
+auto DebugCurrentMountPoints(udisks_sd::proxy_wrappers::UdisksFilesystem& fs)
+    -> coro::Task<> {
+  // Reading mount points again costs a D-Bus round trip; only do it when they
+  // are actually logged.
+  if (!spdlog::should_log(spdlog::level::debug)) {
+    co_return;
+  }
+
+  const auto mnt_points{co_await coro::GetProperty(
+      fs.getProxy(),
+      udisks_sd::proxy_wrappers::UdisksFilesystem::INTERFACE_NAME,
+      "MountPoints")};
+  if (mnt_points) {
+    DebugMountPointsProperty(*mnt_points);
+  }
+}
+
+/// Classify why UDisks failed to mount, to know whether retrying may help.
+MountError ClassifyMountError(const sdbus::Error& error) {
+  using udisks_sd::ErrorName;
+  using udisks_sd::UdisksErrors;
+
+  if (error.getName() == ErrorName(UdisksErrors::kUdisksErrorDeviceBusy) ||
+      error.getName() == ErrorName(UdisksErrors::kUdisksErrorTimedOut) ||
+      // UDisks did not reply in time, such as while it is busy probing a
+      // freshly plugged in disk.
+      error.getName() == "org.freedesktop.DBus.Error.NoReply" ||
+      error.getName() == "org.freedesktop.DBus.Error.Timeout") {
+    return MountError::kTransient;
+  }
+
+  // Failures of mount(8) itself, or of a UDisks job still running on the
+  // device, all share the generic error name: look at the message.
+  if (error.getName() == ErrorName(UdisksErrors::kUdisksErrorFailed)) {
+    static constexpr std::array kTransientMessages{
+        "busy", "No medium found", "not ready", "in progress",
+        "Resource temporarily unavailable"};
+    const std::string_view message{error.getMessage()};
+    if (std::ranges::any_of(kTransientMessages, [message](const char* part) {
+          return message.contains(part);
+        })) {
+      return MountError::kTransient;
+    }
+  }
+
+  return MountError::kPermanent;
+}
+
+}  // namespace
 
-  const notify::Notification notif{
-      .summary{"Mounted drive"},
-      .body{std::format("{} at {}", blk_name, mnt_point)},
-      .app_icon{blk_icon_name},
-      // FIXME: on KDE Plasma 6.4.4, notifications close/crash
-      // instantly if actions are given. Almost certainly a Plasma bug, and
-      // even it were unsupported capabilities, it should ignore them, and not
-      // crash and burn.
-      .actions{action_open_fm, action_open_fm_text},
+notify::Notification MountedNotification(
+    const std::vector<MountedFilesystem>& mounts, const std::string& icon_name,
+    std::uint32_t replaces_id) {
+  std::string body{};
+  for (const auto& entry : mounts) {
+    if (!body.empty()) {
+      body += '\n';
+    }
+    body += std::format("{} at {}", entry.name, entry.mnt_point);
+  }
+
+  return notify::Notification{
+      .summary{mounts.size() == 1
+                   ? std::string{"Mounted drive"}
+                   : std::format("Mounted {} filesystems", mounts.size())},
+      .body{std::move(body)},
+      .app_icon{icon_name.empty() ? "drive-removable-media" : icon_name},
+      .replaces_id = replaces_id,
       .hints{{{"action_icons", sdbus::Variant{true}},
               {"category", sdbus::Variant{"device.added"}},
               {"sound_name", sdbus::Variant{"device-added-media"}}}}};
+}
+
+Notifier::Notifier(notify::Client& client, process::Launcher* launcher,
+                   loop::MainLoop* loop, pool::WorkerPool* pool,
+                   const config::Config* config)
+    : client_{&client},
+      launcher_{launcher},
+      loop_{loop},
+      pool_{loop == nullptr ? nullptr : pool},
+      config_{config} {}
+
+Notifier::~Notifier() noexcept {
+  for (const auto& [key, group] : groups_) {
+    if (group.timer) {
+      loop_->Remove(*group.timer);
+    }
+  }
+}
+
+void Notifier::Mounted(const std::string& group,
+                       const objects::BlockProperties& blk,
+                       const objects::DriveProperties* drive,
+                       const std::string& mnt_point) {
+  auto& grouped{groups_[group]};
+  grouped.mounts.push_back(MountedFilesystem{.name = BlockName(blk, drive),
+                                             .mnt_point = mnt_point});
+  if (grouped.icon_name.empty()) {
+    grouped.icon_name = blk.hint_icon_name;
+  }
+
+  // Mounts arriving while sending are listed by an update, once sent.
+  if (grouped.sending) {
+    return;
+  }
+  const auto window{Window()};
+  if (loop_ == nullptr || window == std::chrono::milliseconds::zero()) {
+    Send(group);
+
+    return;
+  }
+  // Already waiting for the window to end.
+  if (grouped.timer && grouped.timer_kind == Timer::kSend) {
+    return;
+  }
+
+  if (grouped.timer) {
+    loop_->Remove(*grouped.timer);
+  }
+  grouped.timer = loop_->AddTimer(window, [this, group] { Send(group); });
+  grouped.timer_kind = Timer::kSend;
+}
 
-  std::shared_ptr<sdbus::IProxy> notify_proxy =
-      sdbus::createProxy(notify::kNotifServiceName, notify::kNotifObjectPath);
+std::chrono::milliseconds Notifier::Window() const {
+  return config_ != nullptr ? config_->Get().options.notify_window
+                            : std::chrono::milliseconds::zero();
+}
+
+void Notifier::Send(const std::string& group) {
+  const auto it{groups_.find(group)};
+  if (it == groups_.end()) {
+    return;
+  }
+  auto& grouped{it->second};
+  // Called by the timer, or right away when there is no window.
+  if (grouped.timer) {
+    loop_->Remove(*grouped.timer);
+    grouped.timer.reset();
+  }
 
-  auto open_app_fn{[=](std::uint32_t id, std::string action_key) {
-    if (action_key == action_open_fm) {
-      if (int command_value{OpenPathWithDefaultApp(mnt_point)};
-          SystemCommandFailed(command_value)) {
-        spdlog::warn(
-            "xdg-open might have failed; check if xdg-utils is installed");
+  const std::string action_open_fm{"system-file-manager"};
+  const std::string action_open_fm_text{"Open in File Manager"};
+
+  std::vector<std::string> mnt_points{};
+  for (const auto& entry : grouped.mounts) {
+    mnt_points.push_back(entry.mnt_point);
+  }
+
+  auto notif{
+      MountedNotification(grouped.mounts, grouped.icon_name, grouped.id)};
+  // FIXME: on KDE Plasma 6.4.4, notifications close/crash
+  // instantly if actions are given. Almost certainly a Plasma bug, and
+  // even it were unsupported capabilities, it should ignore them, and not
+  // crash and burn.
+  notify::ActionInvokedCallback open_app_fn{};
+  if (launcher_ != nullptr && client_->HasCapability("actions")) {
+    notif.actions = {action_open_fm, action_open_fm_text};
+
+    open_app_fn = [client = client_, launcher = launcher_, action_open_fm,
+                   mnt_points = std::move(mnt_points), group](
+                      std::uint32_t id, const std::string& action_key) {
+      if (action_key == action_open_fm) {
+        for (const auto& mnt_point : mnt_points) {
+          OpenPathWithDefaultApp(*launcher, mnt_point, group);
+        }
+
+        client->CloseNotification(id);
       }
+    };
+  }
 
-      notify::CloseNotification(*notify_proxy, id);
-    }
-  }};
+  const auto previously_sent{grouped.sent};
+  grouped.sending = true;
+  grouped.sent = grouped.mounts.size();
 
-  return notify::Notify(*notify_proxy, notif, open_app_fn);
+  if (pool_ == nullptr) {
+    const trace::Span span{"Notify", group};
+    OnSent(group, client_->Notify(notif, std::move(open_app_fn)));
+
+    return;
+  }
+
+  // Written by the worker, read by the completion on the loop thread.
+  auto notif_id{std::make_shared<std::uint32_t>()};
+  if (!pool_->Submit(
+          [client = client_, notif = std::move(notif),
+           open_app_fn = std::move(open_app_fn), notif_id, group] {
+            const trace::Span span{"Notify", group};
+            *notif_id = client->Notify(notif, open_app_fn);
+          },
+          [this, group, notif_id] { OnSent(group, *notif_id); })) {
+    // Nothing was sent: try again once another window has passed.
+    spdlog::warn("Too many notifications pending, retrying later");
+    grouped.sending = false;
+    grouped.sent = previously_sent;
+    grouped.timer = loop_->AddTimer(Window(), [this, group] { Send(group); });
+    grouped.timer_kind = Timer::kSend;
+  }
 }
 
-auto Mount(udisks_sd::proxy_wrappers::UdisksFilesystem& fs)
-    -> std::optional<std::string> {
-  try {
-    auto mnt_point{fs.Mount({})};
+void Notifier::OnSent(const std::string& group, std::uint32_t id) {
+  const auto it{groups_.find(group)};
+  if (it == groups_.end()) {
+    return;
+  }
+  auto& grouped{it->second};
+  grouped.sending = false;
+
+  if (loop_ == nullptr) {
+    groups_.erase(it);
+
+    return;
+  }
+  if (id != 0) {
+    grouped.id = id;
+  }
 
-    spdlog::debug("Current mount points:");
-    DebugMountPoints(GetMountPoints(fs));
+  // Mounted while sending: update the notification once the window ends.
+  if (grouped.mounts.size() > grouped.sent) {
+    grouped.timer = loop_->AddTimer(Window(), [this, group] { Send(group); });
+    grouped.timer_kind = Timer::kSend;
+
+    return;
+  }
+  // Sending failed and there is no notification to update: later mounts of
+  // the drive start a new one.
+  if (grouped.id == 0) {
+    groups_.erase(it);
+
+    return;
+  }
+  grouped.timer =
+      loop_->AddTimer(kUpdateWindow, [this, group] { groups_.erase(group); });
+  grouped.timer_kind = Timer::kForget;
+}
 
-    return mnt_point;
-  } catch (const sdbus::Error& e) {
-    if (e.getName() ==
-        udisks_sd::ErrorName(
-            udisks_sd::UdisksErrors::kUdisksErrorAlreadyMounted)) {
-      spdlog::warn(
-          "{} is already mounted but UDisks initially returned no mount paths;",
-          fs.getProxy().getObjectPath().c_str());
-      spdlog::debug("Current mount points after trying to mount:");
-      DebugMountPoints(GetMountPoints(fs));
+auto Mount(udisks_sd::proxy_wrappers::UdisksFilesystem& fs,
+           const profiles::MountOptions& options, record::Writer* recorder)
+    -> coro::Task<MountResult> {
+  const trace::Span span{"Mount", fs.getProxy().getObjectPath()};
+  auto call{fs.getProxy().createMethodCall(
+      sdbus::InterfaceName{
+          udisks_sd::proxy_wrappers::UdisksFilesystem::INTERFACE_NAME},
+      sdbus::MethodName{"Mount"})};
+  call << options;
+
+  const auto start{stats::Clock::now()};
+  auto reply{co_await coro::MethodCall{fs.getProxy(), std::move(call)}};
+  const auto latency{stats::Clock::now() - start};
+  stats::Record(stats::Stage::kMountCall, latency);
+  if (reply) {
+    std::string mnt_point{};
+    *reply >> mnt_point;
+    if (recorder != nullptr) {
+      recorder->MountReply(fs.getProxy().getObjectPath(), latency, {},
+                           mnt_point);
     }
 
-    spdlog::error("Failed to automount: {}", e.what());
+    co_await DebugCurrentMountPoints(fs);
 
-    return std::nullopt;
+    co_return mnt_point;
+  }
+
+  const sdbus::Error& error{reply.error()};
+  stats::Global().failures.Add(error.getName());
+  if (recorder != nullptr) {
+    recorder->MountReply(fs.getProxy().getObjectPath(), latency,
+                         error.getName(), {});
+  }
+  const logging::Fields fields{.object_path =
+                                   fs.getProxy().getObjectPath()};
+  if (error.getName() ==
+      udisks_sd::ErrorName(
+          udisks_sd::UdisksErrors::kUdisksErrorAlreadyMounted)) {
+    logging::Warn(fields,
+                  "{} is already mounted but UDisks initially returned no "
+                  "mount paths;",
+                  fs.getProxy().getObjectPath().c_str());
+    co_await DebugCurrentMountPoints(fs);
   }
+
+  const MountError mount_error{ClassifyMountError(error)};
+  if (mount_error == MountError::kTransient) {
+    logging::Warn(fields, "Could not automount yet: {}", error.what());
+  } else {
+    logging::Error(fields, "Failed to automount: {}", error.what());
+  }
+
+  co_return std::unexpected{mount_error};
 }
 
-}  // namespace
+policy::Decision Decide(const Context& context,
+                        const objects::BlockProperties& blk,
+                        const objects::DriveProperties* drive) {
+  return context.config != nullptr
+             ? context.config->Get().policy.Decide(blk, drive)
+             : policy::Decision{};
+}
+
+std::optional<std::string_view> RejectReason(
+    const objects::BlockProperties& blk, const policy::Decision& decision) {
+  if (decision.automount == false) {
+    return "denied by policy";
+  }
+  // Allowed whatever the hints say.
+  if (decision.automount == true) {
+    return std::nullopt;
+  }
+  if (blk.hint_ignore) {
+    return "ignore hint was true";
+  }
+  if (blk.hint_system) {
+    return "system device";
+  }
+  if (!blk.hint_auto) {
+    return "automount hint was false";
+  }
+  if (blk.loop && blk.read_only) {
+    return "read-only loop device";
+  }
+  if (blk.loop) {
+    const auto backing_file{objects::ViewByteString(blk.loop_backing_file)};
+    if (std::ranges::any_of(kPackageImageDirs,
+                            [backing_file](std::string_view dir) {
+                              return backing_file.starts_with(dir);
+                            })) {
+      return "loop device of a package image";
+    }
+  }
+
+  return std::nullopt;
+}
 
 // TODO: read from fstab, etc., for any additional mount points
 // that UDisks may not know about, and mount to them.
-auto TryAutomount(objects::BlockDevice& blk_device)
-    -> std::optional<std::string> {
-  udisks_sd::proxy_wrappers::UdisksBlock& blk{blk_device.Block()};
+bool ShouldAutomount(objects::BlockDevice& blk_device,
+                     const policy::Decision& decision) {
+  const objects::BlockProperties& blk{blk_device.Properties()};
 
-  if (!blk.HintAuto()) {
-    PrintNotAutomounting(blk_device, "automount hint was false");
+  if (const auto reason{RejectReason(blk, decision)}) {
+    SkipAutomount(blk_device, *reason);
 
-    return std::nullopt;
+    return false;
   }
   // Could there even not be a filesystem if HintAuto was false?
   if (!blk_device.HasFilesystem()) {
-    PrintNotAutomounting(blk_device, "no filesystem found");
+    SkipAutomount(blk_device, "no filesystem found");
 
-    return std::nullopt;
+    return false;
   }
   // If mount points already exist, no need to automount it.
-  if (!GetMountPoints(blk_device.Filesystem()).empty()) {
-    PrintNotAutomounting(blk_device, "already mounted");
+  if (!blk.mount_points.empty()) {
+    SkipAutomount(blk_device, "already mounted");
 
-    return std::nullopt;
+    return false;
   }
 
-  auto mnt_point{Mount(blk_device.Filesystem())};
-  if (!mnt_point) {
-    return std::nullopt;
-  }
+  return true;
+}
 
-  spdlog::info("Automounted {}", *mnt_point);
-  if (options::NotifyEnabled()) {
-    NotifyMounted(blk, *mnt_point);
+auto Automount(objects::BlockDevice& blk_device,
+               const objects::DriveProperties* drive, Context context)
+    -> coro::Task<MountResult> {
+  // Copied: the block device and drive may be moved, or change, while
+  // mounting.
+  const objects::BlockProperties blk{blk_device.Properties()};
+  const auto drive_copy{drive != nullptr
+                            ? std::optional<objects::DriveProperties>{*drive}
+                            : std::nullopt};
+  const std::string object_path{blk_device.ObjectPath()};
+  // Mounts of one drive are notified together.
+  const std::string group{blk.drive != udisks::kEmptyObjectPath
+                              ? blk.drive
+                              : blk_device.ObjectPath()};
+
+  const auto* const drive_props{drive_copy ? &*drive_copy : nullptr};
+  const policy::Decision decision{Decide(context, blk, drive_props)};
+
+  auto result{co_await Mount(blk_device.Filesystem(),
+                             decision.options != nullptr
+                                 ? *decision.options
+                                 : profiles::Select(blk, drive_props),
+                             context.recorder)};
+  if (result) {
+    stats::Global().mounts.fetch_add(1, std::memory_order_relaxed);
+    logging::Info({.object_path = object_path,
+                   .mount_point = *result,
+                   .fstype = blk.id_type},
+                  "Automounted {}", *result);
+    const bool notify{context.config == nullptr ||
+                      context.config->Get().options.notify};
+    if (context.notifier != nullptr && notify && decision.notify) {
+      context.notifier->Mounted(group, blk, drive_props, *result);
+    }
   }
 
-  return mnt_point;
+  co_return result;
 }
 
 }  // namespace mount
@@ -23,20 +23,200 @@
 #ifndef UDISKEN_MOUNT_HPP_
 #define UDISKEN_MOUNT_HPP_
 
-#include "udisks.hpp"
+#include "config.hpp"
+#include "coro.hpp"
+#include "loop.hpp"
+#include "notify.hpp"
+#include "policy.hpp"
+#include "pool.hpp"
+#include "process.hpp"
+#include "profiles.hpp"
 
 #include <sdbus-c++/IConnection.h>
+#include <sdbus-c++/IProxy.h>
 #include <sdbus-c++/ProxyInterfaces.h>
 #include <sdbus-c++/Types.h>
-#include <udisks-sdbus-cpp/udisks_proxy.hpp>
+#include <udisks-sdbus-cpp/udisks_proxy_wrappers.hpp>
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+namespace objects {
+class BlockDevice;
+struct BlockProperties;
+struct DriveProperties;
+}  // namespace objects
+
+namespace record {
+class Writer;
+}  // namespace record
+
 namespace mount {
 
+/// Filesystem listed by a mount notification.
+struct MountedFilesystem {
+  /// Name of the block device, as presented to the user.
+  std::string name;
+  std::string mnt_point;
+};
+
+/// Build the notification listing mounted filesystems, without its actions.
+///
+/// @param mounts Filesystems mounted, in order.
+/// @param icon_name Icon of the drive; empty for a generic one.
+/// @param replaces_id ID of the notification it updates; 0 if none.
+notify::Notification MountedNotification(
+    const std::vector<MountedFilesystem>& mounts, const std::string& icon_name,
+    std::uint32_t replaces_id);
+
+/// Notifies mount points, one notification per drive.
+///
+/// Filesystems of one drive mounted within a short window, such as the
+/// partitions of a disk just plugged in, are listed in a single notification.
+/// Filesystems of that drive mounted shortly after it was sent update it in
+/// place, rather than popping up another one.
+class Notifier {
+ public:
+  /// @param client Client sending the notifications.
+  /// @param launcher Launcher of the file manager, when the notification's
+  /// action is invoked; nullptr if no action should be offered.
+  /// @param loop Loop running the window timers; nullptr to notify each mount
+  /// right away.
+  /// @param pool Workers sending the notifications, so that the loop does not
+  /// wait for the notification server; nullptr to send them from the calling
+  /// thread. Requires a loop.
+  /// @param config Configuration, setting the delay during which mounts of
+  /// one drive are grouped; nullptr to notify each mount right away.
+  ///
+  /// All must outlive the notifier.
+  Notifier(notify::Client& client, process::Launcher* launcher,
+           loop::MainLoop* loop, pool::WorkerPool* pool,
+           const config::Config* config);
+
+  Notifier(const Notifier&) = delete;
+  Notifier(Notifier&&) = delete;
+  Notifier& operator=(const Notifier&) = delete;
+  Notifier& operator=(Notifier&&) = delete;
+
+  /// Cancels the pending notifications.
+  ~Notifier() noexcept;
+
+  /// Notify that a filesystem was mounted.
+  ///
+  /// @param group Object path of the drive the filesystem is on, or of the
+  /// block device itself if it has no drive.
+  /// @param blk Properties of the mounted block device.
+  /// @param drive Properties of its drive; nullptr if unknown, or if it has
+  /// none.
+  /// @param mnt_point Path to the mount point.
+  void Mounted(const std::string& group, const objects::BlockProperties& blk,
+               const objects::DriveProperties* drive,
+               const std::string& mnt_point);
+
+ private:
+  /// What the timer of a group is for.
+  enum class Timer {
+    /// Sending the notification once the window ends.
+    kSend,
+    /// Forgetting the group once updates are no longer expected.
+    kForget,
+  };
+
+  struct Group {
+    std::vector<MountedFilesystem> mounts{};
+    std::string icon_name{};
+    /// ID of the sent notification, replaced by updates; 0 until sent.
+    std::uint32_t id{};
+    /// Number of mounts listed by the notification being, or last, sent.
+    std::size_t sent{};
+    /// The notification is being sent by a worker.
+    bool sending{};
+    /// Timer sending the notification, or forgetting the group.
+    std::optional<loop::SourceId> timer{};
+    Timer timer_kind{Timer::kSend};
+  };
+
+  /// Send or update the notification of a group.
+  void Send(const std::string& group);
+  /// Delay during which mounts of one drive are grouped, as configured.
+  std::chrono::milliseconds Window() const;
+  /// Keep track of a group's notification once sent.
+  ///
+  /// @param id ID of the notification; 0 if sending it failed.
+  void OnSent(const std::string& group, std::uint32_t id);
+
+  notify::Client* client_;
+  process::Launcher* launcher_;
+  loop::MainLoop* loop_;
+  pool::WorkerPool* pool_;
+  const config::Config* config_;
+  /// Groups of mounts, by drive object path.
+  std::map<std::string, Group> groups_{};
+};
+
+/// Block devices not on removable drives, such as loop devices, start
+/// mounting at most this often by default. A storm of them, as when booting,
+/// does not keep UDisks from mounting removable media, which is never
+/// throttled.
+constexpr std::chrono::milliseconds kThrottleInterval{100};
+
+/// Services used when automounting, besides UDisks. They must outlive the
+/// mounts in progress.
+struct Context {
+  /// Notifier of mount points; nullptr if notifications are disabled.
+  Notifier* notifier{};
+  /// Loop on which failed mounts are retried; nullptr if they should not be.
+  loop::MainLoop* loop{};
+  /// Configuration, including the automount policy; nullptr for the defaults
+  /// and no policy.
+  const config::Config* config{};
+  /// Recording of UDisks traffic; nullptr if not recording.
+  record::Writer* recorder{};
+  /// Time between the start of two mounts of block devices not on removable
+  /// drives; zero not to throttle them. Requires a loop.
+  std::chrono::milliseconds throttle_interval{kThrottleInterval};
+};
+
 using MountPoints = std::vector<std::string>;
 
+/// Why mounting failed.
+enum class MountError {
+  /// The device may be mountable later: it is busy, its media is not ready,
+  /// or UDisks timed out.
+  kTransient,
+  /// Retrying will not help, such as for an unknown filesystem or a denied
+  /// authorization.
+  kPermanent,
+};
+
+/// Path to the mount point, or why mounting failed.
+using MountResult = std::expected<std::string, MountError>;
+
+/// Converts an array of array of bytes (D-Bus equivalent type: aay) to a
+/// vector of strings.
+///
+/// @param aay The array of array of bytes.
+auto ConvertArrayArrayByte(const std::vector<std::vector<std::uint8_t>>& aay)
+    -> std::vector<std::string>;
+
+/// Views an array of null-terminated byte arrays, such as mount points, as
+/// strings; see objects::ViewByteString.
+///
+/// @param aay The array of byte arrays; must outlive the views.
+/// @param resource Allocates the views, such as the arena of an event.
+auto ViewArrayArrayByte(const std::vector<std::vector<std::uint8_t>>& aay,
+                        std::pmr::memory_resource* resource)
+    -> std::pmr::vector<std::string_view>;
+
 /// Retrieves mount points from a filesystem and converts them to standard
 /// library types.
 ///
@@ -48,18 +228,69 @@ MountPoints GetMountPoints(
 /// Log mount points as verbose output.
 ///
 /// @param mnt_points List of strings representing a filesystem's mount points.
-void DebugMountPoints(const MountPoints& mnt_points);
+void DebugMountPoints(std::span<const std::string_view> mnt_points);
 
-/// Try to mount a block device's filesystem, to be used when automatically
-/// mounting.
+/// Mount a filesystem without blocking the event loop.
+///
+/// @param fs Reference to an UDisks Filesystem proxy, which must outlive the
+/// task. Destroying the task cancels the mount call.
+/// @param options Options of the mount call, such as those of a profile; only
+/// read when the task starts.
+/// @param recorder Records the reply; nullptr if not recording. Must outlive
+/// the task.
+///
+/// @return Task producing the path to the mount point, or why mounting failed.
+auto Mount(udisks_sd::proxy_wrappers::UdisksFilesystem& fs,
+           const profiles::MountOptions& options,
+           record::Writer* recorder = nullptr) -> coro::Task<MountResult>;
+
+/// Decision of the policy of a context for a block device.
+///
+/// @param drive Properties of its drive; nullptr if unknown, or if it has
+/// none.
+policy::Decision Decide(const Context& context,
+                        const objects::BlockProperties& blk,
+                        const objects::DriveProperties* drive);
+
+/// Early rejection of block devices which will not be automounted, whatever
+/// their filesystem, judging from their properties alone: the policy, UDisks
+/// hints, and read-only or package loop devices, such as snaps. Cheap enough
+/// to run on every announced block device, before creating any proxy for it.
+///
+/// @param decision Decision of the policy for the block device; a device the
+/// policy allows is never rejected.
+///
+/// @return Why the block device is rejected; nullopt if it may be automounted.
+std::optional<std::string_view> RejectReason(
+    const objects::BlockProperties& blk, const policy::Decision& decision);
+
+/// Should a block device's filesystem be automatically mounted? Logs why not,
+/// counting each reason once per block device.
+///
+/// @param decision Decision of the policy for the block device.
+///
+/// @return False if the filesystem should not be automounted, or is already
+/// mounted somewhere.
+bool ShouldAutomount(objects::BlockDevice& blk_device,
+                     const policy::Decision& decision);
+
+/// Mount a block device's filesystem, to be used when automounting.
+///
+/// The filesystem is mounted with the options of the policy, or else of its
+/// profile. The result is logged, and notified unless disabled, including by
+/// the policy.
 ///
-/// @return Path to mount point after mounting, or nothing if the
-/// filesystem is already mounted somewhere.
+/// @param blk_device Block device to automount, which must have a filesystem.
+/// Only read when the task starts: its filesystem proxy must outlive the task,
+/// but the block device itself may be moved.
+/// @param drive Properties of the drive of the block device, naming it in
+/// notifications; nullptr if unknown. Only read when the task starts, too.
+/// @param context Services used to notify the mount point, and policy.
 ///
-/// @throws sdbus::Error Error returned by UDisks if automounting
-/// failed. Does not throw if filesystem is already mounted somewhere.
-auto TryAutomount(objects::BlockDevice& blk_device)
-    -> std::optional<std::string>;
+/// @return Task producing the path to the mount point, or why mounting failed.
+auto Automount(objects::BlockDevice& blk_device,
+               const objects::DriveProperties* drive, Context context)
+    -> coro::Task<MountResult>;
 
 }  // namespace mount
 
@@ -22,72 +22,93 @@
 
 #include "notify.hpp"
 
+#include "stats.hpp"
+
 #include <sdbus-c++/Error.h>
+#include <sdbus-c++/IConnection.h>
 #include <sdbus-c++/IProxy.h>
 #include <sdbus-c++/Types.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace notify {
 
 namespace {
 
-/// Print the notification server's capabilities as verbose output.
+/// Query the notification server's capabilities.
 /// See Freedesktop.org Notifications documentation:
 /// <https://specifications.freedesktop.org/notification-spec/latest/>
-void DebugCapabilities(sdbus::IProxy& notify_proxy) {
+///
+/// @return Capabilities, or nothing if the server could not be reached.
+auto GetCapabilities(sdbus::IProxy& notify_proxy) -> std::vector<std::string> {
   std::vector<std::string> caps{};
-  notify_proxy.callMethod("GetCapabilities")
-      .onInterface(kNotifInterfaceName)
-      .storeResultsTo(caps);
+  try {
+    notify_proxy.callMethod("GetCapabilities")
+        .onInterface(kNotifInterfaceName)
+        .storeResultsTo(caps);
+  } catch (const sdbus::Error& e) {
+    spdlog::warn("Could not query notification server capabilities: {}",
+                 e.what());
+  }
 
-  spdlog::debug("== Notification server capabilities ==");
+  return caps;
+}
+
+/// Print the notification server's capabilities as verbose output.
+void DebugCapabilities(const std::vector<std::string>& caps) {
+  SPDLOG_DEBUG("== Notification server capabilities ==");
   for (const auto& cap : caps) {
-    spdlog::debug("{}", cap);
+    SPDLOG_DEBUG("{}", cap);
   }
-  spdlog::debug("== End of capabilities ==");
+  SPDLOG_DEBUG("== End of capabilities ==");
 }
 
 }  // namespace
 
-bool CloseNotification(sdbus::IProxy& notify_proxy, std::uint32_t id) {
-  spdlog::debug("Closing notification with ID {}", id);
+Client::Client()
+    : connection_{sdbus::createSessionBusConnection()},
+      proxy_{sdbus::createProxy(*connection_, kNotifServiceName,
+                                kNotifObjectPath)},
+      capabilities_{GetCapabilities(*proxy_)} {
+  DebugCapabilities(capabilities_);
 
-  try {
-    notify_proxy.callMethod("CloseNotification")
-        .onInterface(kNotifInterfaceName)
-        .withArguments(id);
-  } catch (const sdbus::Error& e) {
-    // If the notification expired or already got closed, the D-Bus error
-    // message will be empty.
-    if (!e.getMessage().empty()) {
-      spdlog::error("Error when trying to close notification: {}", e.what());
-
-      return false;
-    }
-  }
+  proxy_->uponSignal("ActionInvoked")
+      .onInterface(kNotifInterfaceName)
+      .call([this](std::uint32_t id, const std::string& action_key) {
+        OnActionInvoked(id, action_key);
+      });
+  proxy_->uponSignal("NotificationClosed")
+      .onInterface(kNotifInterfaceName)
+      .call([this](std::uint32_t id, std::uint32_t reason) {
+        OnNotificationClosed(id, reason);
+      });
 
-  return true;
+  connection_->enterEventLoopAsync();
 }
 
-bool Notify(sdbus::IProxy& notify_proxy, const Notification& notif,
-            ActionInvokedCallback callback) {
-  DebugCapabilities(notify_proxy);
+Client::~Client() noexcept { connection_->leaveEventLoop(); }
 
-  spdlog::debug("Registering notifications actions");
-  notify_proxy.uponSignal("ActionInvoked")
-      .onInterface(kNotifInterfaceName)
-      .call(callback);
+bool Client::HasCapability(std::string_view capability) const {
+  return capabilities_.empty() ||
+         std::ranges::contains(capabilities_, capability);
+}
 
+std::uint32_t Client::Notify(const Notification& notif,
+                             ActionInvokedCallback callback) {
   std::uint32_t notif_id{};
-  spdlog::debug("Sending notification: [{}] {}", notif.summary, notif.body);
+  SPDLOG_DEBUG("Sending notification: [{}] {}", notif.summary, notif.body);
   try {
+    const stats::ScopedTimer timer{stats::Stage::kNotify};
     // XXX: if you get "Notifications.Error.ExcessNotificationGeneration" and
     // you have recently upgraded your packages, make sure to reboot ;)
-    notify_proxy.callMethod("Notify")
+    proxy_->callMethod("Notify")
         .onInterface(kNotifInterfaceName)
         .withArguments(notif.app_name, notif.replaces_id, notif.app_icon,
                        notif.summary, notif.body, notif.actions, notif.hints,
@@ -99,7 +120,54 @@ bool Notify(sdbus::IProxy& notify_proxy, const Notification& notif,
 
   // notif_id will always be greater than zero if sending notification
   // succeeded.
-  return notif_id != 0;
+  if (notif_id != 0 && callback) {
+    const std::scoped_lock lock{callbacks_mutex_};
+    callbacks_.insert_or_assign(notif_id, std::move(callback));
+  }
+
+  return notif_id;
+}
+
+bool Client::CloseNotification(std::uint32_t id) {
+  SPDLOG_DEBUG("Closing notification with ID {}", id);
+
+  try {
+    proxy_->callMethod("CloseNotification")
+        .onInterface(kNotifInterfaceName)
+        .withArguments(id);
+  } catch (const sdbus::Error& e) {
+    // If the notification expired or already got closed, the D-Bus error
+    // message will be empty.
+    if (!e.getMessage().empty()) {
+      spdlog::error("Error when trying to close notification: {}", e.what());
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Client::OnActionInvoked(std::uint32_t id, const std::string& action_key) {
+  ActionInvokedCallback callback{};
+  {
+    const std::scoped_lock lock{callbacks_mutex_};
+    const auto it{callbacks_.find(id)};
+    if (it == callbacks_.end()) {
+      // Not one of our notifications.
+      return;
+    }
+    callback = it->second;
+  }
+
+  // Called without the lock held: the callback may close the notification.
+  callback(id, action_key);
+}
+
+void Client::OnNotificationClosed(std::uint32_t id,
+                                  [[maybe_unused]] std::uint32_t reason) {
+  const std::scoped_lock lock{callbacks_mutex_};
+  callbacks_.erase(id);
 }
 
 }  // namespace notify
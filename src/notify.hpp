@@ -25,12 +25,17 @@
 
 #include "options.hpp"
 
+#include <sdbus-c++/IConnection.h>
 #include <sdbus-c++/IProxy.h>
 #include <sdbus-c++/Types.h>
 
 #include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 /// Send Freedesktop.org desktop notifications.
@@ -69,24 +74,70 @@ static const sdbus::ObjectPath kNotifObjectPath{
     "/org/freedesktop/Notifications"};
 static const sdbus::InterfaceName kNotifInterfaceName{kNotifServiceName};
 
-/// Close a Desktop notification with its ID.
+/// Long-lived client to the notification server.
 ///
-/// @param notify_proxy Proxy to the org.freedesktop.Notifications service.
-/// @param id Desktop notification ID, returned by
-/// org.freedesktop.Notifications.Notify.
-///
-/// @return Notification did not expire or get manually closed, and closed
-/// successfully.
-bool CloseNotification(sdbus::IProxy& notify_proxy, std::uint32_t id);
+/// Owns one session bus connection and proxy for the whole session, queries
+/// the server's capabilities once, and dispatches the ActionInvoked signal to
+/// the callback of the notification it was invoked on.
+class Client {
+ public:
+  /// Connect to the notification server using a new session bus connection,
+  /// processed on its own thread.
+  ///
+  /// Notifications can then be sent from any thread, such as workers of a
+  /// pool::WorkerPool, without holding up the main loop.
+  ///
+  /// @throws sdbus::Error Could not connect to the session bus.
+  Client();
 
-/// Send a desktop notification.
-///
-/// @param notify_proxy Proxy to the org.freedesktop.Notifications service.
-/// @param notification Notification.
-///
-/// @return Successfully sent the notification.
-bool Notify(sdbus::IProxy& notify_proxy, const Notification& notif,
-            ActionInvokedCallback callback);
+  Client(const Client&) = delete;
+  Client(Client&&) = delete;
+  Client& operator=(const Client&) = delete;
+  Client& operator=(Client&&) = delete;
+
+  ~Client() noexcept;
+
+  /// Does the notification server support this capability?
+  ///
+  /// @param capability Capability name, such as "actions" or "body".
+  ///
+  /// @return True if the capability was advertised by the server, or if the
+  /// server's capabilities could not be queried.
+  bool HasCapability(std::string_view capability) const;
+
+  /// Send a desktop notification.
+  ///
+  /// @param notif Notification.
+  /// @param callback Called when an action is invoked on this notification.
+  /// Forgotten once the notification is closed.
+  ///
+  /// @return ID of the sent notification; 0 if sending it failed.
+  std::uint32_t Notify(const Notification& notif,
+                       ActionInvokedCallback callback = {});
+
+  /// Close a Desktop notification with its ID.
+  ///
+  /// @param id Desktop notification ID, returned by Notify.
+  ///
+  /// @return Notification did not expire or get manually closed, and closed
+  /// successfully.
+  bool CloseNotification(std::uint32_t id);
+
+ private:
+  void OnActionInvoked(std::uint32_t id, const std::string& action_key);
+  void OnNotificationClosed(std::uint32_t id, std::uint32_t reason);
+
+  std::unique_ptr<sdbus::IConnection> connection_;
+  std::unique_ptr<sdbus::IProxy> proxy_;
+  /// Capabilities of the notification server, queried once.
+  std::vector<std::string> capabilities_;
+
+  /// Guards callbacks_: notifications are sent from worker threads, while
+  /// signals are received on the session bus thread.
+  std::mutex callbacks_mutex_;
+  /// Action callbacks of notifications still open, by notification ID.
+  std::map<std::uint32_t, ActionInvokedCallback> callbacks_;
+};
 
 }  // namespace notify
 
@@ -22,17 +22,12 @@
 
 #include "options.hpp"
 
-#include "spdlog/spdlog.h"
-
 #include <cstdlib>
+#include <filesystem>
 #include <string>
 
 namespace options {
 
-constexpr bool NonZero(std::string_view sv) {
-  return !sv.empty() && sv.find_first_not_of("0") != std::string_view::npos;
-}
-
 static_assert(NonZero("1"));
 static_assert(NonZero("101"));
 static_assert(NonZero("010"));
@@ -44,14 +39,15 @@ bool NonZeroEnvVar(const std::string& var) {
   return var_value != nullptr && NonZero(var_value);
 }
 
-bool NotifyEnabled() {
-  if (NonZeroEnvVar("UDISKEN_NO_NOTIFY")) {
-    spdlog::debug("Notifications disabled by environment.");
-
-    return false;
+std::filesystem::path ConfigDir() {
+  const auto* const config_home{std::getenv("XDG_CONFIG_HOME")};
+  if (config_home != nullptr && *config_home != '\0') {
+    return std::filesystem::path{config_home} / globals::kAppName;
   }
 
-  return true;
+  const auto* const home{std::getenv("HOME")};
+  return std::filesystem::path{home != nullptr ? home : ""} / ".config" /
+         globals::kAppName;
 }
 
 }  // namespace options
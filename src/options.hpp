@@ -25,7 +25,10 @@
 
 #include <sdbus-c++/Types.h>
 
+#include <chrono>
+#include <filesystem>
 #include <string>
+#include <string_view>
 
 /// Status options enabled at compile-time for UDISKEN.
 namespace globals {
@@ -57,7 +60,9 @@ namespace options {
 ///
 /// @return True if string view is non-empty (regardless of the original
 /// string's content), and its content contains characters other than '0'.
-constexpr bool NonZero(std::string_view sv);
+constexpr bool NonZero(std::string_view sv) {
+  return !sv.empty() && sv.find_first_not_of("0") != std::string_view::npos;
+}
 
 /// Checks if the environment variable is defined and has a non-zero value.
 ///
@@ -71,12 +76,15 @@ bool NonZeroEnvVar(const std::string& var);
 struct Options {
   /// Should we send Desktop notifications?
   bool notify{true};
+  /// Filesystems of one drive mounted within this delay are notified
+  /// together.
+  std::chrono::milliseconds notify_window{500};
 };
 
-/// Are desktop notifications enabled by the environment?
+/// Directory of UDISKEN's configuration files.
 ///
-/// @return False if UDISKEN_NO_NOTIFY is non-zero. True otherwise.
-bool NotifyEnabled();
+/// @return $XDG_CONFIG_HOME/udisken, or ~/.config/udisken.
+std::filesystem::path ConfigDir();
 
 }  // namespace options
 
@@ -0,0 +1,286 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Automount policy, from a rule file.
+
+#include "policy.hpp"
+
+#include "arena.hpp"
+#include "options.hpp"
+#include "profiles.hpp"
+#include "udisks.hpp"
+
+#include <sdbus-c++/Types.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory_resource>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace policy {
+
+namespace {
+
+/// Name of the backing file field, matched by path rather than exactly.
+constexpr std::string_view kBackingFileField{"backing-file"};
+constexpr std::string_view kOptionsAction{"options="};
+
+/// Split a rule line into words, up to a comment. Double-quoted words may
+/// contain spaces.
+///
+/// @return Words; nullopt if a quote is not closed.
+std::optional<std::vector<std::string>> Split(std::string_view line) {
+  std::vector<std::string> words{};
+  for (std::size_t pos{line.find_first_not_of(" \t")};
+       pos != std::string_view::npos && line[pos] != '#';
+       pos = line.find_first_not_of(" \t", pos)) {
+    if (line[pos] == '"') {
+      const auto end{line.find('"', pos + 1)};
+      if (end == std::string_view::npos) {
+        return std::nullopt;
+      }
+      words.emplace_back(line.substr(pos + 1, end - pos - 1));
+      pos = end + 1;
+    } else {
+      const auto end{line.find_first_of(" \t", pos)};
+      words.emplace_back(line.substr(pos, end - pos));
+      pos = end;
+    }
+  }
+
+  return words;
+}
+
+}  // namespace
+
+void Policy::Actions::Merge(const Actions& other) {
+  if (other.automount) {
+    automount = other.automount;
+  }
+  if (other.options) {
+    options = other.options;
+  }
+  if (other.notify) {
+    notify = other.notify;
+  }
+}
+
+void Policy::Actions::Apply(Decision& decision, bool& notify_decided) const {
+  if (automount && !decision.automount) {
+    decision.automount = automount;
+  }
+  if (options && decision.options == nullptr) {
+    decision.options = &*options;
+  }
+  if (notify && !notify_decided) {
+    decision.notify = *notify;
+    notify_decided = true;
+  }
+}
+
+Policy::Policy(std::string_view text, std::string_view source) {
+  std::size_t line_number{0};
+  for (const auto line : std::views::split(text, '\n')) {
+    AddRule(std::string_view{line.begin(), line.end()}, source, ++line_number);
+  }
+}
+
+Policy Policy::Load(const std::filesystem::path& path) {
+  std::ifstream file{path};
+  if (!file) {
+    SPDLOG_DEBUG("No automount policy at {}", path.string());
+
+    return {};
+  }
+
+  const std::string text{std::istreambuf_iterator<char>{file},
+                         std::istreambuf_iterator<char>{}};
+  Policy policy{text, path.string()};
+  spdlog::info("Loaded {} automount policy rules from {}", policy.Size(),
+               path.string());
+
+  return policy;
+}
+
+std::filesystem::path Policy::DefaultPath() {
+  return options::ConfigDir() / "policy";
+}
+
+void Policy::AddRule(std::string_view line, std::string_view source,
+                     std::size_t line_number) {
+  const auto words{Split(line)};
+  if (!words) {
+    spdlog::warn("{}:{}: unterminated quote; ignoring rule", source,
+                 line_number);
+
+    return;
+  }
+  if (words->empty()) {
+    return;
+  }
+  if (words->size() < 3) {
+    spdlog::warn("{}:{}: expected a field, a value and actions; ignoring rule",
+                 source, line_number);
+
+    return;
+  }
+
+  Actions actions{};
+  for (const auto& word : *words | std::views::drop(2)) {
+    if (word == "allow") {
+      actions.automount = true;
+    } else if (word == "deny") {
+      actions.automount = false;
+    } else if (word == "silent") {
+      actions.notify = false;
+    } else if (word.starts_with(kOptionsAction)) {
+      actions.options = profiles::MountOptions{
+          {"options", sdbus::Variant{word.substr(kOptionsAction.size())}}};
+    } else {
+      spdlog::warn("{}:{}: unknown action '{}'; ignoring rule", source,
+                   line_number, word);
+
+      return;
+    }
+  }
+
+  const std::string& field{(*words)[0]};
+  const std::string& value{(*words)[1]};
+  if (field == kBackingFileField) {
+    std::size_t node{0};
+    for (const auto part : std::views::split(value, '/')) {
+      const std::string_view component{part.begin(), part.end()};
+      if (component.empty()) {
+        continue;
+      }
+
+      const auto it{backing_files_[node].children.find(component)};
+      if (it != backing_files_[node].children.end()) {
+        node = it->second;
+        continue;
+      }
+      backing_files_.emplace_back();
+      backing_files_[node].children.emplace(component,
+                                            backing_files_.size() - 1);
+      node = backing_files_.size() - 1;
+    }
+    auto& node_actions{backing_files_[node].actions};
+    if (node_actions) {
+      node_actions->Merge(actions);
+    } else {
+      node_actions = std::move(actions);
+    }
+  } else {
+    static constexpr std::array<std::pair<std::string_view, Field>,
+                                kFieldCount>
+        kFields{{{"uuid", kUuid},
+                 {"label", kLabel},
+                 {"serial", kSerial},
+                 {"model", kModel},
+                 {"fstype", kFsType},
+                 {"bus", kBus}}};
+    const auto known{
+        std::ranges::find(kFields, std::string_view{field},
+                          &std::pair<std::string_view, Field>::first)};
+    if (known == kFields.end()) {
+      spdlog::warn("{}:{}: unknown field '{}'; ignoring rule", source,
+                   line_number, field);
+
+      return;
+    }
+    tables_[known->second][value].Merge(actions);
+  }
+
+  ++size_;
+}
+
+Decision Policy::Decide(const objects::BlockProperties& blk,
+                        const objects::DriveProperties* drive) const {
+  Decision decision{};
+  if (size_ == 0) {
+    return decision;
+  }
+
+  bool notify_decided{false};
+  const auto apply{[this, &decision, &notify_decided](Field field,
+                                                      std::string_view value) {
+    const auto& table{tables_[field]};
+    if (value.empty() || table.empty()) {
+      return;
+    }
+    if (const auto it{table.find(value)}; it != table.end()) {
+      it->second.Apply(decision, notify_decided);
+    }
+  }};
+
+  apply(kUuid, blk.id_uuid);
+  apply(kLabel, blk.id_label);
+  if (drive != nullptr) {
+    apply(kSerial, drive->serial);
+    apply(kModel, drive->model);
+  }
+
+  if (blk.loop) {
+    const auto backing_file{objects::ViewByteString(blk.loop_backing_file)};
+    // The rules of the deepest directories are the most specific.
+    arena::Arena<256> arena{};
+    std::pmr::vector<const Actions*> matched{arena.Resource()};
+    std::size_t node{0};
+    if (backing_files_[node].actions) {
+      matched.push_back(&*backing_files_[node].actions);
+    }
+    for (const auto part : std::views::split(backing_file, '/')) {
+      const std::string_view component{part.begin(), part.end()};
+      if (component.empty()) {
+        continue;
+      }
+
+      const auto it{backing_files_[node].children.find(component)};
+      if (it == backing_files_[node].children.end()) {
+        break;
+      }
+      node = it->second;
+      if (backing_files_[node].actions) {
+        matched.push_back(&*backing_files_[node].actions);
+      }
+    }
+    for (const auto* const actions : matched | std::views::reverse) {
+      actions->Apply(decision, notify_decided);
+    }
+  }
+
+  apply(kFsType, blk.id_type);
+  if (drive != nullptr) {
+    apply(kBus, drive->connection_bus);
+  }
+
+  return decision;
+}
+
+}  // namespace policy
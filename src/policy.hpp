@@ -0,0 +1,172 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Automount policy, from a rule file.
+
+#ifndef UDISKEN_POLICY_HPP_
+#define UDISKEN_POLICY_HPP_
+
+#include "profiles.hpp"
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace objects {
+struct BlockProperties;
+struct DriveProperties;
+}  // namespace objects
+
+/// Automount policy: rules overriding, per device, whether to automount, how,
+/// and whether to notify.
+///
+/// Rules are read from a file, one per line:
+///
+///     # <field> <value> <action>...
+///     uuid          2C1E-90F7              allow
+///     label         "My Backups"           deny
+///     fstype        ntfs                   options=noatime,windows_names
+///     model         "Cruzer Blade"         silent
+///     backing-file  /home/user/images      allow silent
+///
+/// Fields are the filesystem's uuid, label and fstype, the drive's serial,
+/// model and bus (such as "usb"), and the backing file of loop devices, which
+/// matches files under it when it is a directory. Values containing spaces are
+/// double-quoted. Actions are:
+/// - allow: automount, even if UDisks hints not to;
+/// - deny: never automount;
+/// - options=OPTIONS: mount with these options instead of the profile's;
+/// - silent: do not notify the mount.
+///
+/// When rules of several fields match, the most specific field decides each
+/// action, in this order: uuid, label, serial, model, backing-file, fstype,
+/// bus.
+namespace policy {
+
+/// What the policy decided for a device.
+struct Decision {
+  /// Automount even if UDisks hints not to (true), never (false), or as hinted
+  /// (nullopt).
+  std::optional<bool> automount{};
+  /// Options overriding those of the profile; nullptr to use the profile. Valid
+  /// as long as the policy.
+  const profiles::MountOptions* options{};
+  /// Notify the mount.
+  bool notify{true};
+};
+
+/// Rules compiled into lookup tables: deciding costs one hash lookup per
+/// field, and one per backing file path component, however many rules there
+/// are.
+class Policy {
+ public:
+  /// No rules: every decision is left to UDisks hints.
+  Policy() = default;
+
+  /// Compile rules. Invalid lines are logged and skipped.
+  ///
+  /// @param text Rules, in the format described above.
+  /// @param source Where the rules come from, such as a file path, for logs.
+  Policy(std::string_view text, std::string_view source);
+
+  /// Load rules from a file.
+  ///
+  /// @return Policy of the file; no rules if it does not exist or cannot be
+  /// read.
+  static Policy Load(const std::filesystem::path& path);
+
+  /// Default rule file: $XDG_CONFIG_HOME/udisken/policy, or
+  /// ~/.config/udisken/policy.
+  static std::filesystem::path DefaultPath();
+
+  /// Decide for a block device, from its cached properties only.
+  ///
+  /// @param drive Properties of its drive; nullptr if unknown, or if it has
+  /// none.
+  Decision Decide(const objects::BlockProperties& blk,
+                  const objects::DriveProperties* drive) const;
+
+  /// Number of rules.
+  std::size_t Size() const { return size_; }
+
+ private:
+  /// Fields matched exactly, from the most specific.
+  enum Field : std::size_t {
+    kUuid,
+    kLabel,
+    kSerial,
+    kModel,
+    kFsType,
+    kBus,
+    kFieldCount,
+  };
+
+  struct Actions {
+    std::optional<bool> automount{};
+    std::optional<profiles::MountOptions> options{};
+    std::optional<bool> notify{};
+
+    /// Set the actions of another rule, overriding those set here.
+    void Merge(const Actions& other);
+    /// Set the actions of a decision not decided yet, by a more specific
+    /// rule.
+    ///
+    /// @param notify_decided Whether notifying was decided, since Decision
+    /// defaults to notifying; set once it is.
+    void Apply(Decision& decision, bool& notify_decided) const;
+  };
+
+  /// Lookup of std::string keys from string views.
+  struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view sv) const {
+      return std::hash<std::string_view>{}(sv);
+    }
+  };
+  using Table =
+      std::unordered_map<std::string, Actions, StringHash, std::equal_to<>>;
+
+  /// Node of the backing file trie, one level per path component.
+  struct PathNode {
+    /// Indices of the children nodes, by path component.
+    std::unordered_map<std::string, std::size_t, StringHash, std::equal_to<>>
+        children{};
+    std::optional<Actions> actions{};
+  };
+
+  /// Compile one line; logs why it is invalid.
+  void AddRule(std::string_view line, std::string_view source,
+               std::size_t line_number);
+  /// Rules matching exactly, by field.
+  std::array<Table, kFieldCount> tables_{};
+  /// Backing file rules; the first node is the root directory.
+  std::vector<PathNode> backing_files_{PathNode{}};
+  std::size_t size_{};
+};
+
+}  // namespace policy
+
+#endif  // UDISKEN_POLICY_HPP_
@@ -0,0 +1,90 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Run blocking work on worker threads, off the event loop.
+
+#include "pool.hpp"
+
+#include "loop.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace pool {
+
+WorkerPool::WorkerPool(loop::MainLoop& loop, unsigned threads,
+                       std::size_t capacity)
+    : loop_{&loop}, capacity_{capacity} {
+  workers_.reserve(threads);
+  for (unsigned i{}; i < threads; ++i) {
+    workers_.emplace_back([this] { RunWorker(); });
+  }
+}
+
+WorkerPool::~WorkerPool() noexcept {
+  {
+    const std::scoped_lock lock{mutex_};
+    stopping_ = true;
+    works_.clear();
+  }
+  work_available_.notify_all();
+
+  // Joined here rather than by their destructors, while members they use are
+  // still alive.
+  workers_.clear();
+}
+
+bool WorkerPool::Submit(loop::Callback work, loop::Callback done) {
+  {
+    const std::scoped_lock lock{mutex_};
+    if (works_.size() >= capacity_) {
+      return false;
+    }
+    works_.push_back(Work{.work = std::move(work), .done = std::move(done)});
+  }
+  work_available_.notify_one();
+
+  return true;
+}
+
+void WorkerPool::RunWorker() {
+  for (;;) {
+    Work work{};
+    {
+      std::unique_lock lock{mutex_};
+      work_available_.wait(lock,
+                           [this] { return stopping_ || !works_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      work = std::move(works_.front());
+      works_.pop_front();
+    }
+
+    work.work();
+    if (work.done) {
+      loop_->Defer(std::move(work.done));
+    }
+  }
+}
+
+}  // namespace pool
@@ -0,0 +1,93 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Run blocking work on worker threads, off the event loop.
+
+#ifndef UDISKEN_POOL_HPP_
+#define UDISKEN_POOL_HPP_
+
+#include "loop.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Run blocking work on worker threads, off the event loop.
+namespace pool {
+
+/// Small, bounded pool of worker threads.
+///
+/// Work submitted by the loop thread runs on a worker; its completion is handed
+/// back to the loop thread through the loop's lock-free deferred queue, so that
+/// the loop thread does not wait for the work, however slow it is.
+///
+/// Only notifications are sent from it. Creating UDisks proxies still blocks
+/// the loop thread, on the AddMatch round trips with which the generated
+/// proxies register their signals.
+class WorkerPool {
+ public:
+  /// @param loop Loop running the completions; must outlive the pool.
+  /// @param threads Number of worker threads.
+  /// @param capacity Maximum number of submitted works not started yet.
+  WorkerPool(loop::MainLoop& loop, unsigned threads, std::size_t capacity);
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool(WorkerPool&&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+  WorkerPool& operator=(WorkerPool&&) = delete;
+
+  /// Waits for the works already started; works not started are dropped,
+  /// along with their completions.
+  ~WorkerPool() noexcept;
+
+  /// Run work on a worker thread.
+  ///
+  /// @param work Called on a worker thread.
+  /// @param done Called on the loop thread once work returned.
+  ///
+  /// @return Work submitted; false if too much work is already waiting.
+  bool Submit(loop::Callback work, loop::Callback done = {});
+
+ private:
+  struct Work {
+    loop::Callback work;
+    loop::Callback done;
+  };
+
+  void RunWorker();
+
+  loop::MainLoop* loop_;
+  std::size_t capacity_;
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::deque<Work> works_{};
+  bool stopping_{false};
+
+  /// Declared last: workers must start after, and stop before, the rest.
+  std::vector<std::jthread> workers_{};
+};
+
+}  // namespace pool
+
+#endif  // UDISKEN_POOL_HPP_
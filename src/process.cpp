@@ -0,0 +1,165 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Launch helper programs, such as xdg-open, without blocking.
+
+#include "process.hpp"
+
+#include "trace.hpp"
+
+#include <spawn.h>
+#include <spdlog/spdlog.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace process {
+
+namespace {
+
+/// Open a pidfd, readable once the process exits. Wrapped here since older
+/// C libraries do not provide pidfd_open.
+///
+/// @return The pidfd, or -1 on failure, with errno set.
+int PidfdOpen(pid_t pid) {
+  return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+}  // namespace
+
+Launcher::Launcher() : epoll_fd_{epoll_create1(EPOLL_CLOEXEC)} {
+  if (epoll_fd_ < 0) {
+    throw std::system_error{errno, std::generic_category(),
+                            "could not create epoll instance"};
+  }
+}
+
+Launcher::~Launcher() noexcept {
+  for (const auto& child : children_) {
+    close(child.pidfd);
+  }
+  close(epoll_fd_);
+}
+
+std::optional<pid_t> Launcher::Spawn(std::vector<std::string> args,
+                                     ExitCallback callback,
+                                     std::string_view object_path) {
+  if (args.empty()) {
+    return std::nullopt;
+  }
+
+  const trace::Span span{"Spawn", object_path};
+  std::vector<char*> argv{};
+  argv.reserve(args.size() + 1);
+  for (auto& arg : args) {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid{};
+  if (const int err{posix_spawnp(&pid, argv.front(), nullptr, nullptr,
+                                 argv.data(), environ)};
+      err != 0) {
+    spdlog::warn("Could not launch {}: {}", args.front(),
+                 std::generic_category().message(err));
+
+    return std::nullopt;
+  }
+  SPDLOG_DEBUG("Launched {} with PID {}", args.front(), pid);
+
+  // Tracked before its exit is watched: should it exit right away, the loop
+  // thread reaping it must find it.
+  const std::scoped_lock lock{children_mutex_};
+  const int pidfd{PidfdOpen(pid)};
+  if (pidfd >= 0) {
+    children_.push_back(
+        Child{.pid = pid, .pidfd = pidfd, .callback = std::move(callback)});
+  }
+  epoll_event event{.events = EPOLLIN, .data{.fd = pidfd}};
+  if (pidfd < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, pidfd, &event) < 0) {
+    // Without pidfd (Linux < 5.3), the program will be reaped by init once
+    // UDISKEN exits; until then, it stays a zombie.
+    spdlog::warn("Cannot watch {} (PID {}): {}", args.front(), pid,
+                 std::generic_category().message(errno));
+    if (pidfd >= 0) {
+      children_.pop_back();
+      close(pidfd);
+    }
+  }
+
+  return pid;
+}
+
+void Launcher::ReapChildren() {
+  std::vector<std::pair<ExitCallback, int>> exited{};
+
+  {
+    const std::scoped_lock lock{children_mutex_};
+
+    // Level-triggered: should more children have exited, the file descriptor
+    // stays readable and this is called again.
+    std::array<epoll_event, 8> events{};
+    const int count{epoll_wait(epoll_fd_, events.data(),
+                               static_cast<int>(events.size()), 0)};
+    for (const auto& event : std::span{events}.first(
+             static_cast<std::size_t>(std::max(count, 0)))) {
+      const auto child{std::ranges::find(children_, event.data.fd,
+                                         &Child::pidfd)};
+      if (child == children_.end()) {
+        continue;
+      }
+
+      int status{};
+      if (waitpid(child->pid, &status, WNOHANG) != child->pid) {
+        continue;
+      }
+      SPDLOG_DEBUG("PID {} exited with status {}", child->pid, status);
+
+      // Closing the pidfd also removes it from the epoll instance.
+      close(child->pidfd);
+      exited.emplace_back(std::move(child->callback), status);
+      children_.erase(child);
+    }
+  }
+
+  // Called without the lock held: callbacks may launch other programs.
+  for (const auto& [callback, status] : exited) {
+    if (callback) {
+      callback(status);
+    }
+  }
+}
+
+}  // namespace process
@@ -0,0 +1,103 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Launch helper programs, such as xdg-open, without blocking.
+
+#ifndef UDISKEN_PROCESS_HPP_
+#define UDISKEN_PROCESS_HPP_
+
+#include <sys/types.h>
+
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Launch helper programs, such as xdg-open, without blocking.
+namespace process {
+
+/// Callback function type, for when a launched program exited.
+///
+/// Function returns nothing, and takes the wait status of the program, to be
+/// inspected with WIFEXITED, WEXITSTATUS, etc. (type: int).
+using ExitCallback = std::function<void(int)>;
+
+/// Launches programs directly, without a shell, and reaps them asynchronously.
+///
+/// Each launched program is watched through a pidfd. All pidfds are grouped
+/// behind one file descriptor, to be watched by the event loop, which calls
+/// ReapChildren when it becomes readable.
+///
+/// Programs can be launched from any thread; exit callbacks are called on the
+/// thread calling ReapChildren.
+class Launcher {
+ public:
+  /// @throws std::system_error Could not create the epoll instance.
+  Launcher();
+
+  Launcher(const Launcher&) = delete;
+  Launcher(Launcher&&) = delete;
+  Launcher& operator=(const Launcher&) = delete;
+  Launcher& operator=(Launcher&&) = delete;
+
+  /// Running programs are neither waited for nor killed.
+  ~Launcher() noexcept;
+
+  /// Launch a program, searched in PATH like execvp(3) does.
+  ///
+  /// @param args Program name, followed by its arguments. Passed as is: no
+  /// shell expansion nor quoting is involved.
+  /// @param callback Called once the program exited.
+  /// @param object_path UDisks object path of the device the program is
+  /// launched for, on whose track the launch is traced; empty if none.
+  ///
+  /// @return PID of the launched program, or nothing if it could not be
+  /// launched.
+  std::optional<pid_t> Spawn(std::vector<std::string> args,
+                             ExitCallback callback = {},
+                             std::string_view object_path = {});
+
+  /// File descriptor that becomes readable when a launched program exits.
+  int Fd() const { return epoll_fd_; }
+
+  /// Reap the launched programs that exited, and call their exit callbacks.
+  /// Never blocks.
+  void ReapChildren();
+
+ private:
+  struct Child {
+    pid_t pid;
+    int pidfd;
+    ExitCallback callback;
+  };
+
+  int epoll_fd_;
+
+  /// Guards children_: programs may be launched from another thread than the
+  /// event loop's.
+  std::mutex children_mutex_;
+  std::vector<Child> children_;
+};
+
+}  // namespace process
+
+#endif  // UDISKEN_PROCESS_HPP_
@@ -0,0 +1,127 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Mount options chosen by filesystem and drive kind.
+
+#include "profiles.hpp"
+
+#include "udisks.hpp"
+
+#include <sdbus-c++/Types.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace profiles {
+
+namespace {
+
+/// Built-in profiles; the first matching one applies.
+///
+/// UDisks already mounts vfat with "flush", writing data out early in case the
+/// media is pulled out, and none of these add "sync", which would slow down and
+/// wear out flash media. Online discard is left off: UDisks does not allow it
+/// by default, and trimming periodically with fstrim(8) is cheaper.
+constexpr std::array kProfiles{
+    // FAT on SD cards is always flash media, whatever rotation rate the card
+    // reader reports.
+    Profile{.fs_type = "vfat", .bus = "sdio", .options = "noatime,lazytime"},
+    Profile{.fs_type = "exfat", .bus = "sdio", .options = "noatime,lazytime"},
+    // Access times are not worth a write to flash media; batch the inode
+    // timestamp updates too.
+    Profile{.media = Media::kNonRotational, .options = "noatime,lazytime"},
+    // Keep relatime, the kernel default, but batch timestamp updates.
+    Profile{.media = Media::kRotational, .options = "lazytime"},
+};
+
+/// Kind of media in a drive.
+///
+/// UDisks reports -1, rotating at an unknown rate, whenever the kernel does
+/// not know better, as behind most USB mass storage bridges and card readers:
+/// USB sticks and SD cards report it too. On those buses, it is taken for
+/// flash media.
+Media MediaOf(const objects::DriveProperties& drive) {
+  if (drive.rotation_rate == 0) {
+    return Media::kNonRotational;
+  }
+  if (drive.rotation_rate < 0 &&
+      (drive.connection_bus == "usb" || drive.connection_bus == "sdio")) {
+    return Media::kNonRotational;
+  }
+
+  return Media::kRotational;
+}
+
+bool Matches(const Profile& profile, const objects::BlockProperties& blk,
+             const objects::DriveProperties* drive) {
+  if (!profile.fs_type.empty() && profile.fs_type != blk.id_type) {
+    return false;
+  }
+  if (!profile.bus.empty() &&
+      (drive == nullptr || profile.bus != drive->connection_bus)) {
+    return false;
+  }
+
+  switch (profile.media) {
+    case Media::kAny:
+      return true;
+    case Media::kRotational:
+    case Media::kNonRotational:
+      return drive != nullptr && MediaOf(*drive) == profile.media;
+    default:
+      return false;
+  }
+}
+
+/// Options of each built-in profile, in the same order.
+const std::array<MountOptions, kProfiles.size()>& BuiltOptions() {
+  static const auto built{[] {
+    std::array<MountOptions, kProfiles.size()> options{};
+    for (std::size_t index{0}; index < kProfiles.size(); ++index) {
+      options[index].emplace(
+          "options", sdbus::Variant{std::string{kProfiles[index].options}});
+    }
+    return options;
+  }()};
+
+  return built;
+}
+
+}  // namespace
+
+const MountOptions& Select(const objects::BlockProperties& blk,
+                           const objects::DriveProperties* drive) {
+  static const MountOptions kDefaults{};
+
+  const auto profile{std::ranges::find_if(
+      kProfiles, [&blk, drive](const Profile& candidate) {
+        return Matches(candidate, blk, drive);
+      })};
+  if (profile == kProfiles.end()) {
+    return kDefaults;
+  }
+
+  return BuiltOptions()[static_cast<std::size_t>(profile - kProfiles.begin())];
+}
+
+}  // namespace profiles
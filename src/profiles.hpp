@@ -0,0 +1,85 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Mount options chosen by filesystem and drive kind.
+
+#ifndef UDISKEN_PROFILES_HPP_
+#define UDISKEN_PROFILES_HPP_
+
+#include <sdbus-c++/Types.h>
+
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace objects {
+struct BlockProperties;
+struct DriveProperties;
+}  // namespace objects
+
+/// Mount options chosen by filesystem type, drive connection bus, and whether
+/// the media rotates.
+///
+/// Options are added to the defaults of UDisks, and must be allowed by its
+/// mount_options.conf(5); the built-in profiles only use options allowed by
+/// default.
+namespace profiles {
+
+/// Options of Filesystem.Mount (D-Bus type: a{sv}).
+using MountOptions = std::map<std::string, sdbus::Variant>;
+
+/// Kind of media a profile applies to.
+enum class Media {
+  kAny,
+  /// Spinning disks.
+  kRotational,
+  /// Flash media, such as USB sticks, SD cards, and SSDs. Includes USB and SD
+  /// drives of unknown rotation rate, which are mostly flash.
+  kNonRotational,
+};
+
+/// Mount options for one kind of filesystem on one kind of drive.
+struct Profile {
+  /// Filesystem type (IdType), such as "vfat"; empty to match any.
+  std::string_view fs_type{};
+  /// Connection bus of the drive (ConnectionBus), such as "usb"; empty to
+  /// match any.
+  std::string_view bus{};
+  Media media{Media::kAny};
+  /// Comma-separated mount options.
+  std::string_view options{};
+};
+
+/// Mount options of the first profile matching a block device.
+///
+/// The options of each profile are built once, and shared by all mounts.
+///
+/// @param drive Properties of the drive of the block device; nullptr if it
+/// has none, such as a loop device, in which case only profiles matching any
+/// bus and media apply.
+///
+/// @return Options to mount the block device with; empty, for the defaults of
+/// UDisks, if no profile matches. Valid until the program exits.
+const MountOptions& Select(const objects::BlockProperties& blk,
+                           const objects::DriveProperties* drive);
+
+}  // namespace profiles
+
+#endif  // UDISKEN_PROFILES_HPP_
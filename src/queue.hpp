@@ -0,0 +1,104 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Queues passing work between threads.
+
+#ifndef UDISKEN_QUEUE_HPP_
+#define UDISKEN_QUEUE_HPP_
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+/// Queues passing work between threads.
+namespace queue {
+
+/// Unbounded lock-free queue with many producers and a single consumer.
+///
+/// Pushing is one atomic exchange, and never waits for other producers or the
+/// consumer. Based on Dmitry Vyukov's intrusive MPSC node-based queue.
+///
+/// Pop may miss a value whose Push has not returned yet; producers should
+/// wake up the consumer after pushing, e.g. through an eventfd, so that it
+/// pops again.
+template <class T>
+class MpscQueue {
+ public:
+  MpscQueue() : head_{&stub_}, tail_{&stub_} {}
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue(MpscQueue&&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+  MpscQueue& operator=(MpscQueue&&) = delete;
+
+  /// Must not be called while values are being pushed.
+  ~MpscQueue() noexcept {
+    while (Pop()) {
+    }
+    if (tail_ != &stub_) {
+      delete tail_;
+    }
+  }
+
+  /// Push a value. Can be called from any thread.
+  void Push(T value) {
+    auto* const node{new Node{.next{nullptr}, .value{std::move(value)}}};
+    Node* const prev{head_.exchange(node, std::memory_order_acq_rel)};
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  /// Pop the oldest value. Must only be called from the consumer thread.
+  ///
+  /// @return The value, or nothing if the queue is empty.
+  std::optional<T> Pop() {
+    Node* const tail{tail_};
+    Node* const next{tail->next.load(std::memory_order_acquire)};
+    if (next == nullptr) {
+      return std::nullopt;
+    }
+
+    // next becomes the new stub; its value is moved out.
+    tail_ = next;
+    std::optional<T> value{std::move(next->value)};
+    next->value.reset();
+    if (tail != &stub_) {
+      delete tail;
+    }
+
+    return value;
+  }
+
+ private:
+  struct Node {
+    std::atomic<Node*> next;
+    std::optional<T> value;
+  };
+
+  /// Node without value, the queue's first node when it was never pushed to.
+  Node stub_{.next{nullptr}, .value{}};
+  /// Last pushed node, where producers append.
+  std::atomic<Node*> head_;
+  /// Node before the oldest value, popped by the consumer.
+  Node* tail_;
+};
+
+}  // namespace queue
+
+#endif  // UDISKEN_QUEUE_HPP_
@@ -0,0 +1,383 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Record UDisks traffic to a compact binary file, and read it back to replay
+/// it, such as to turn an event storm into a repeatable benchmark.
+
+#include "record.hpp"
+
+#include "udisks.hpp"
+
+#include <sdbus-c++/Types.h>
+
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace record {
+
+namespace {
+
+constexpr std::string_view kMagic{"UDKNREC"};
+constexpr std::uint8_t kVersion{1};
+
+/// Strings, and the sdbus-c++ types deriving from them, such as object paths.
+template <class T>
+concept StringLike = std::derived_from<T, std::string>;
+
+template <class T>
+struct IsVector : std::false_type {};
+template <class T>
+struct IsVector<std::vector<T>> : std::true_type {};
+
+// Encoding.
+
+void Put(std::string& out, std::unsigned_integral auto value) {
+  const std::uint64_t wide{value};
+  for (std::size_t byte{}; byte < sizeof(value); ++byte) {
+    out.push_back(static_cast<char>((wide >> (8 * byte)) & 0xFFU));
+  }
+}
+
+void Put(std::string& out, std::signed_integral auto value) {
+  Put(out, static_cast<std::make_unsigned_t<decltype(value)>>(value));
+}
+
+void Put(std::string& out, bool value) {
+  Put(out, static_cast<std::uint8_t>(value ? 1 : 0));
+}
+
+void Put(std::string& out, double value) {
+  Put(out, std::bit_cast<std::uint64_t>(value));
+}
+
+void Put(std::string& out, std::string_view value) {
+  Put(out, static_cast<std::uint32_t>(value.size()));
+  out.append(value);
+}
+
+template <StringLike T>
+void Put(std::string& out, const T& value) {
+  Put(out, std::string_view{value});
+}
+
+// Vectors and spans nest, such as for aay.
+template <class T>
+void Put(std::string& out, const std::vector<T>& values);
+
+template <class T>
+void Put(std::string& out, std::span<const T> values) {
+  Put(out, static_cast<std::uint32_t>(values.size()));
+  for (const auto& value : values) {
+    Put(out, value);
+  }
+}
+
+template <class T>
+void Put(std::string& out, const std::vector<T>& values) {
+  Put(out, std::span<const T>{values});
+}
+
+/// Append a property value, tagged with its type.
+///
+/// @return The value is of a recorded type, and was appended.
+template <std::size_t kIndex = 0>
+bool PutValue(std::string& out, const sdbus::Variant& value) {
+  if constexpr (kIndex == std::tuple_size_v<ValueTypes>) {
+    return false;
+  } else {
+    using T = std::tuple_element_t<kIndex, ValueTypes>;
+    if (value.containsValueOfType<T>()) {
+      Put(out, static_cast<std::uint8_t>(kIndex));
+      Put(out, value.get<T>());
+
+      return true;
+    }
+
+    return PutValue<kIndex + 1>(out, value);
+  }
+}
+
+/// @tparam Properties objects::PropertyMap, or objects::ChangedProperties.
+template <class Properties>
+  requires std::same_as<typename Properties::mapped_type, sdbus::Variant>
+void Put(std::string& out, const Properties& properties) {
+  // Patched once the recorded properties are counted.
+  const auto count_at{out.size()};
+  Put(out, std::uint32_t{});
+
+  std::uint32_t count{};
+  for (const auto& [name, value] : properties) {
+    const auto name_at{out.size()};
+    Put(out, name);
+    if (PutValue(out, value)) {
+      ++count;
+    } else {
+      out.resize(name_at);
+    }
+  }
+
+  std::string patch{};
+  Put(patch, count);
+  out.replace(count_at, patch.size(), patch);
+}
+
+void Put(std::string& out, const objects::InterfaceMap& interfaces) {
+  Put(out, static_cast<std::uint32_t>(interfaces.size()));
+  for (const auto& [name, properties] : interfaces) {
+    Put(out, name);
+    Put(out, properties);
+  }
+}
+
+// Decoding.
+
+/// Reads values off a stream.
+class Decoder {
+ public:
+  explicit Decoder(std::istream& in) : in_{&in} {}
+
+  void Read(char* data, std::size_t size) {
+    if (!in_->read(data, static_cast<std::streamsize>(size))) {
+      throw std::runtime_error{"truncated recording"};
+    }
+  }
+
+  template <class T>
+  T Get() {
+    if constexpr (std::same_as<T, bool>) {
+      return Get<std::uint8_t>() != 0;
+    } else if constexpr (std::unsigned_integral<T>) {
+      std::array<char, sizeof(T)> bytes{};
+      Read(bytes.data(), bytes.size());
+      T value{};
+      for (std::size_t byte{}; byte < sizeof(T); ++byte) {
+        value |= static_cast<T>(
+            static_cast<T>(static_cast<unsigned char>(bytes[byte]))
+            << (8 * byte));
+      }
+
+      return value;
+    } else if constexpr (std::signed_integral<T>) {
+      return static_cast<T>(Get<std::make_unsigned_t<T>>());
+    } else if constexpr (std::same_as<T, double>) {
+      return std::bit_cast<double>(Get<std::uint64_t>());
+    } else if constexpr (StringLike<T>) {
+      std::string value(Get<std::uint32_t>(), '\0');
+      Read(value.data(), value.size());
+
+      return T{std::move(value)};
+    } else if constexpr (IsVector<T>::value) {
+      T values{};
+      const auto count{Get<std::uint32_t>()};
+      for (std::uint32_t i{}; i < count; ++i) {
+        values.push_back(Get<typename T::value_type>());
+      }
+
+      return values;
+    } else if constexpr (std::same_as<T, objects::PropertyMap>) {
+      T properties{};
+      const auto count{Get<std::uint32_t>()};
+      for (std::uint32_t i{}; i < count; ++i) {
+        auto name{Get<sdbus::PropertyName>()};
+        properties.emplace(std::move(name), GetValue(Get<std::uint8_t>()));
+      }
+
+      return properties;
+    } else {
+      static_assert(std::same_as<T, objects::InterfaceMap>);
+      T interfaces{};
+      const auto count{Get<std::uint32_t>()};
+      for (std::uint32_t i{}; i < count; ++i) {
+        auto name{Get<sdbus::InterfaceName>()};
+        interfaces.emplace(std::move(name), Get<objects::PropertyMap>());
+      }
+
+      return interfaces;
+    }
+  }
+
+  /// Read a property value of the type with this tag.
+  template <std::size_t kIndex = 0>
+  sdbus::Variant GetValue(std::uint8_t tag) {
+    if constexpr (kIndex == std::tuple_size_v<ValueTypes>) {
+      throw std::runtime_error{"unknown property type in recording"};
+    } else {
+      if (static_cast<std::size_t>(tag) == kIndex) {
+        return sdbus::Variant{Get<std::tuple_element_t<kIndex, ValueTypes>>()};
+      }
+
+      return GetValue<kIndex + 1>(tag);
+    }
+  }
+
+ private:
+  std::istream* in_;
+};
+
+}  // namespace
+
+Writer::Writer(const std::filesystem::path& path)
+    : file_{path, std::ios::binary | std::ios::trunc} {
+  if (!file_) {
+    throw std::system_error{errno, std::generic_category(),
+                            "could not open recording " + path.string()};
+  }
+
+  file_.write(kMagic.data(), static_cast<std::streamsize>(kMagic.size()));
+  file_.put(static_cast<char>(kVersion));
+  file_.flush();
+}
+
+void Writer::ManagedObject(const sdbus::ObjectPath& object_path,
+                           const objects::InterfaceMap& interfaces) {
+  Begin(Kind::kManagedObject, object_path);
+  Put(buffer_, interfaces);
+  Commit();
+}
+
+void Writer::InterfacesAdded(const sdbus::ObjectPath& object_path,
+                             const objects::InterfaceMap& interfaces) {
+  Begin(Kind::kInterfacesAdded, object_path);
+  Put(buffer_, interfaces);
+  Commit();
+}
+
+void Writer::InterfacesRemoved(
+    const sdbus::ObjectPath& object_path,
+    const std::vector<sdbus::InterfaceName>& interfaces) {
+  Begin(Kind::kInterfacesRemoved, object_path);
+  Put(buffer_, interfaces);
+  Commit();
+}
+
+void Writer::PropertiesChanged(
+    const sdbus::ObjectPath& object_path,
+    const sdbus::InterfaceName& interface,
+    const objects::ChangedProperties& changed,
+    std::span<const sdbus::PropertyName> invalidated) {
+  Begin(Kind::kPropertiesChanged, object_path);
+  Put(buffer_, interface);
+  Put(buffer_, changed);
+  Put(buffer_, invalidated);
+  Commit();
+}
+
+void Writer::MountReply(const sdbus::ObjectPath& object_path,
+                        Clock::duration duration, std::string_view error_name,
+                        std::string_view mount_point) {
+  Begin(Kind::kMountReply, object_path);
+  Put(buffer_, static_cast<std::uint64_t>(
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       duration)
+                       .count()));
+  Put(buffer_, error_name);
+  Put(buffer_, mount_point);
+  Commit();
+}
+
+void Writer::Begin(Kind kind, const sdbus::ObjectPath& object_path) {
+  buffer_.clear();
+  Put(buffer_, static_cast<std::uint8_t>(kind));
+  Put(buffer_, static_cast<std::uint64_t>(
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       Clock::now() - start_)
+                       .count()));
+  Put(buffer_, object_path);
+}
+
+void Writer::Commit() {
+  file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  file_.flush();
+}
+
+Reader::Reader(const std::filesystem::path& path)
+    : file_{path, std::ios::binary} {
+  if (!file_) {
+    throw std::system_error{errno, std::generic_category(),
+                            "could not open recording " + path.string()};
+  }
+
+  std::string magic(kMagic.size() + 1, '\0');
+  if (!file_.read(magic.data(), static_cast<std::streamsize>(magic.size())) ||
+      std::string_view{magic}.substr(0, kMagic.size()) != kMagic) {
+    throw std::runtime_error{path.string() + " is not a UDISKEN recording"};
+  }
+  if (static_cast<std::uint8_t>(magic.back()) != kVersion) {
+    throw std::runtime_error{path.string() +
+                             " was recorded by another UDISKEN version"};
+  }
+}
+
+std::optional<Record> Reader::Next() {
+  if (file_.peek() == std::char_traits<char>::eof()) {
+    return std::nullopt;
+  }
+
+  Decoder decoder{file_};
+  Record record{};
+  record.kind = static_cast<Kind>(decoder.Get<std::uint8_t>());
+  record.time = std::chrono::nanoseconds{decoder.Get<std::int64_t>()};
+  record.object_path = decoder.Get<sdbus::ObjectPath>();
+
+  switch (record.kind) {
+    case Kind::kManagedObject:
+    case Kind::kInterfacesAdded:
+      record.interfaces = decoder.Get<objects::InterfaceMap>();
+      break;
+    case Kind::kInterfacesRemoved:
+      record.removed = decoder.Get<std::vector<sdbus::InterfaceName>>();
+      break;
+    case Kind::kPropertiesChanged: {
+      auto interface{decoder.Get<sdbus::InterfaceName>()};
+      auto changed{decoder.Get<objects::PropertyMap>()};
+      record.interfaces.emplace(std::move(interface), std::move(changed));
+      record.invalidated = decoder.Get<std::vector<sdbus::PropertyName>>();
+      break;
+    }
+    case Kind::kMountReply:
+      record.duration = std::chrono::nanoseconds{decoder.Get<std::int64_t>()};
+      record.error_name = decoder.Get<std::string>();
+      record.mount_point = decoder.Get<std::string>();
+      break;
+    default:
+      throw std::runtime_error{"unknown record in recording"};
+  }
+
+  return record;
+}
+
+}  // namespace record
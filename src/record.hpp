@@ -0,0 +1,150 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Record UDisks traffic to a compact binary file, and read it back to replay
+/// it, such as to turn an event storm into a repeatable benchmark.
+
+#ifndef UDISKEN_RECORD_HPP_
+#define UDISKEN_RECORD_HPP_
+
+#include "udisks.hpp"
+
+#include <sdbus-c++/Types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+/// Record UDisks traffic to a compact binary file, and read it back to replay
+/// it, such as to turn an event storm into a repeatable benchmark.
+///
+/// A file starts with a header, followed by records of what UDisks sent:
+/// objects found by the initial scan, signals, and replies to Mount calls,
+/// each with when it was received. Integers are little-endian. Property
+/// values of types UDISKEN never reads, such as dictionaries, are left out.
+namespace record {
+
+using Clock = std::chrono::steady_clock;
+
+/// Types of the property values recorded, tagged in files by their index: only
+/// append to this list, or bump the file version.
+using ValueTypes =
+    std::tuple<bool, std::uint8_t, std::int16_t, std::uint16_t, std::int32_t,
+               std::uint32_t, std::int64_t, std::uint64_t, double, std::string,
+               sdbus::ObjectPath, std::vector<std::uint8_t>,
+               std::vector<std::vector<std::uint8_t>>, std::vector<std::string>,
+               std::vector<sdbus::ObjectPath>>;
+
+enum class Kind : std::uint8_t {
+  /// Object listed by GetManagedObjects, at startup.
+  kManagedObject = 1,
+  kInterfacesAdded = 2,
+  kInterfacesRemoved = 3,
+  kPropertiesChanged = 4,
+  kMountReply = 5,
+};
+
+/// Recorded UDisks message; which members are set depends on its kind.
+struct Record {
+  Kind kind{};
+  /// Since recording started.
+  std::chrono::nanoseconds time{};
+  sdbus::ObjectPath object_path{};
+  /// Interfaces with their properties; for kPropertiesChanged, the one
+  /// interface whose properties changed.
+  objects::InterfaceMap interfaces{};
+  /// Removed interfaces, for kInterfacesRemoved.
+  std::vector<sdbus::InterfaceName> removed{};
+  /// Properties whose new value was not sent, for kPropertiesChanged.
+  std::vector<sdbus::PropertyName> invalidated{};
+  /// Time UDisks took to reply, for kMountReply.
+  std::chrono::nanoseconds duration{};
+  /// D-Bus error name, for kMountReply; empty if mounting succeeded.
+  std::string error_name{};
+  /// Mount point, for a successful kMountReply.
+  std::string mount_point{};
+};
+
+/// Appends records to a file, as they happen. Used from the loop thread only.
+///
+/// Each record is flushed right away, so that a recording survives UDISKEN
+/// crashing, which is when it is most wanted.
+class Writer {
+ public:
+  /// @param path File to write, replaced if it exists.
+  ///
+  /// @throws std::system_error Could not open the file.
+  explicit Writer(const std::filesystem::path& path);
+
+  void ManagedObject(const sdbus::ObjectPath& object_path,
+                     const objects::InterfaceMap& interfaces);
+  void InterfacesAdded(const sdbus::ObjectPath& object_path,
+                       const objects::InterfaceMap& interfaces);
+  void InterfacesRemoved(const sdbus::ObjectPath& object_path,
+                         const std::vector<sdbus::InterfaceName>& interfaces);
+  void PropertiesChanged(const sdbus::ObjectPath& object_path,
+                         const sdbus::InterfaceName& interface,
+                         const objects::ChangedProperties& changed,
+                         std::span<const sdbus::PropertyName> invalidated);
+  /// @param error_name D-Bus error name; empty if mounting succeeded.
+  void MountReply(const sdbus::ObjectPath& object_path,
+                  Clock::duration duration, std::string_view error_name,
+                  std::string_view mount_point);
+
+ private:
+  /// Start a record in the buffer.
+  void Begin(Kind kind, const sdbus::ObjectPath& object_path);
+  /// Write the buffered record.
+  void Commit();
+
+  std::ofstream file_;
+  Clock::time_point start_{Clock::now()};
+  /// Record being written; reused.
+  std::string buffer_{};
+};
+
+/// Reads back the records of a file.
+class Reader {
+ public:
+  /// @throws std::system_error Could not open the file.
+  /// @throws std::runtime_error Not a recording, or of an unknown version.
+  explicit Reader(const std::filesystem::path& path);
+
+  /// Read the next record.
+  ///
+  /// @throws std::runtime_error The file is truncated or corrupted.
+  ///
+  /// @return The record; nullopt at the end of the file.
+  std::optional<Record> Next();
+
+ private:
+  std::ifstream file_;
+};
+
+}  // namespace record
+
+#endif  // UDISKEN_RECORD_HPP_
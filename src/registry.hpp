@@ -0,0 +1,257 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// In-memory registry of the UDisks objects known to UDISKEN.
+
+#ifndef UDISKEN_REGISTRY_HPP_
+#define UDISKEN_REGISTRY_HPP_
+
+#include "udisks.hpp"
+
+#include <sdbus-c++/Types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// In-memory registry of the UDisks objects known to UDISKEN, kept up to date
+/// from UDisks signals.
+namespace registry {
+
+/// Hash map from object paths to values, with a flat layout.
+///
+/// Entries are stored contiguously, and found through an open addressing
+/// (linear probing) table of indices. Lookups, insertions and removals are
+/// O(1) on average; iterating over entries is as cheap as over a vector.
+///
+/// Pointers and references to values are invalidated by insertions and
+/// removals.
+template <class Value>
+class FlatMap {
+ public:
+  struct Entry {
+    sdbus::ObjectPath key;
+    Value value;
+  };
+
+  std::size_t Size() const { return entries_.size(); }
+  bool Empty() const { return entries_.empty(); }
+
+  auto begin() { return entries_.begin(); }
+  auto end() { return entries_.end(); }
+  auto begin() const { return entries_.begin(); }
+  auto end() const { return entries_.end(); }
+
+  /// Find the value of a key.
+  ///
+  /// @return Pointer to the value, or nullptr if the key is unknown.
+  Value* Find(const sdbus::ObjectPath& key) {
+    const auto slot{FindSlot(key)};
+    return slot ? &entries_[slots_[*slot] - 1].value : nullptr;
+  }
+  const Value* Find(const sdbus::ObjectPath& key) const {
+    const auto slot{FindSlot(key)};
+    return slot ? &entries_[slots_[*slot] - 1].value : nullptr;
+  }
+  bool Contains(const sdbus::ObjectPath& key) const {
+    return FindSlot(key).has_value();
+  }
+
+  /// Insert a value, or replace the value already present for this key.
+  ///
+  /// @return Reference to the value in the map.
+  Value& InsertOrAssign(const sdbus::ObjectPath& key, Value value) {
+    if (auto* const existing{Find(key)}) {
+      // Destroyed then constructed rather than assigned; see Erase.
+      std::destroy_at(existing);
+      std::construct_at(existing, std::move(value));
+
+      return *existing;
+    }
+
+    // Keep the load factor under 3/4.
+    if ((entries_.size() + 1) * 4 > slots_.size() * 3) {
+      Rehash(std::max<std::size_t>(kMinSlots, slots_.size() * 2));
+    }
+
+    entries_.push_back({key, std::move(value)});
+    slots_[FreeSlot(key)] = static_cast<std::uint32_t>(entries_.size());
+
+    return entries_.back().value;
+  }
+
+  /// Remove a key and its value.
+  ///
+  /// @return The key was present.
+  bool Erase(const sdbus::ObjectPath& key) {
+    const auto slot{FindSlot(key)};
+    if (!slot) {
+      return false;
+    }
+
+    const std::size_t index{slots_[*slot] - 1};
+    ClearSlot(*slot);
+
+    // Fill the gap with the last entry, to keep entries contiguous. The erased
+    // entry is destroyed first, rather than assigned over: assignment would
+    // replace its members in declaration order, not in the reverse order
+    // their destructors rely on, such as that of a block device cancelling
+    // its automount task before destroying the proxies it uses.
+    if (const std::size_t last{entries_.size() - 1}; index != last) {
+      slots_[*FindSlot(entries_[last].key)] =
+          static_cast<std::uint32_t>(index + 1);
+      std::destroy_at(&entries_[index]);
+      std::construct_at(&entries_[index], std::move(entries_[last]));
+    }
+    entries_.pop_back();
+
+    return true;
+  }
+
+ private:
+  static constexpr std::size_t kMinSlots{16};
+  /// Slot value for empty slots; other slots store an entry index plus one.
+  static constexpr std::uint32_t kEmptySlot{0};
+
+  std::size_t Mask() const { return slots_.size() - 1; }
+  std::size_t Home(const std::string& key) const {
+    return std::hash<std::string>{}(key) & Mask();
+  }
+
+  std::optional<std::size_t> FindSlot(const sdbus::ObjectPath& key) const {
+    if (slots_.empty()) {
+      return std::nullopt;
+    }
+
+    for (std::size_t slot{Home(key)}; slots_[slot] != kEmptySlot;
+         slot = (slot + 1) & Mask()) {
+      if (entries_[slots_[slot] - 1].key == key) {
+        return slot;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  /// Find the first free slot for a key that is not in the table.
+  std::size_t FreeSlot(const std::string& key) const {
+    std::size_t slot{Home(key)};
+    while (slots_[slot] != kEmptySlot) {
+      slot = (slot + 1) & Mask();
+    }
+
+    return slot;
+  }
+
+  /// Empty a slot, shifting back the following slots of its probe sequence so
+  /// that lookups never stop early.
+  void ClearSlot(std::size_t hole) {
+    for (std::size_t next{(hole + 1) & Mask()}; slots_[next] != kEmptySlot;
+         next = (next + 1) & Mask()) {
+      const std::size_t home{Home(entries_[slots_[next] - 1].key)};
+      // The entry can move back if the hole lies between its home slot and
+      // its current slot.
+      if (((next - home) & Mask()) >= ((next - hole) & Mask())) {
+        slots_[hole] = slots_[next];
+        hole = next;
+      }
+    }
+    slots_[hole] = kEmptySlot;
+  }
+
+  /// @param slot_count New number of slots; must be a power of two.
+  void Rehash(std::size_t slot_count) {
+    slots_.assign(slot_count, kEmptySlot);
+    for (std::size_t index{0}; index < entries_.size(); ++index) {
+      slots_[FreeSlot(entries_[index].key)] =
+          static_cast<std::uint32_t>(index + 1);
+    }
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<std::uint32_t> slots_;
+};
+
+/// Block device rejected early on, which UDISKEN keeps no proxy of.
+///
+/// Its properties are still cached, should they change so that it is no
+/// longer rejected.
+struct RejectedBlockDevice {
+  objects::BlockProperties properties{};
+  /// Interfaces the block device object implements.
+  std::vector<sdbus::InterfaceName> interfaces{};
+};
+
+/// UDisks objects known to UDISKEN.
+struct DeviceRegistry {
+  /// Block devices, with their interface proxies and cached properties.
+  FlatMap<objects::BlockDevice> block_devices{};
+  /// Block devices rejected from their properties alone; see
+  /// mount::RejectReason.
+  FlatMap<RejectedBlockDevice> rejected_block_devices{};
+  /// Drives, with their cached properties.
+  FlatMap<objects::DriveProperties> drives{};
+  /// Object paths of the block devices of each drive, by drive object path.
+  /// Block devices without drive, such as loop devices, are not listed.
+  FlatMap<std::vector<sdbus::ObjectPath>> drive_block_devices{};
+  /// Mount points created by UDISKEN, by block device object path.
+  FlatMap<std::string> mount_points{};
+
+  /// List a block device under its drive. Does nothing for the empty drive
+  /// path "/".
+  void AddToDrive(const sdbus::ObjectPath& drive,
+                  const sdbus::ObjectPath& blk_device) {
+    if (drive == udisks::kEmptyObjectPath) {
+      return;
+    }
+
+    auto* members{drive_block_devices.Find(drive)};
+    if (members == nullptr) {
+      members = &drive_block_devices.InsertOrAssign(drive, {});
+    }
+    if (!std::ranges::contains(*members, blk_device)) {
+      members->push_back(blk_device);
+    }
+  }
+
+  /// Stop listing a block device under its drive.
+  void RemoveFromDrive(const sdbus::ObjectPath& drive,
+                       const sdbus::ObjectPath& blk_device) {
+    auto* const members{drive_block_devices.Find(drive)};
+    if (members == nullptr) {
+      return;
+    }
+
+    std::erase(*members, blk_device);
+    if (members->empty()) {
+      drive_block_devices.Erase(drive);
+    }
+  }
+};
+
+}  // namespace registry
+
+#endif  // UDISKEN_REGISTRY_HPP_
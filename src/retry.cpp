@@ -0,0 +1,47 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Retry failed operations later, with capped exponential backoff.
+
+#include "retry.hpp"
+
+#include "loop.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace retry {
+
+loop::Clock::duration Delay(const Backoff& backoff, unsigned attempt) {
+  // Only ever used from the loop thread.
+  static std::minstd_rand rng{std::random_device{}()};
+
+  auto delay{backoff.initial};
+  for (unsigned i{}; i < attempt && delay < backoff.max; ++i) {
+    delay *= 2;
+  }
+  delay = std::min(delay, backoff.max);
+
+  std::uniform_int_distribution<loop::Clock::rep> jitter{0,
+                                                         delay.count() / 2};
+  return delay - loop::Clock::duration{jitter(rng)};
+}
+
+}  // namespace retry
@@ -0,0 +1,54 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Retry failed operations later, with capped exponential backoff.
+
+#ifndef UDISKEN_RETRY_HPP_
+#define UDISKEN_RETRY_HPP_
+
+#include "loop.hpp"
+
+#include <chrono>
+
+/// Retry failed operations later, with capped exponential backoff.
+namespace retry {
+
+/// How long to wait between attempts, and how many to make.
+struct Backoff {
+  /// Delay before the first retry; doubled for each following one.
+  loop::Clock::duration initial{std::chrono::milliseconds{500}};
+  /// Maximum delay between two attempts.
+  loop::Clock::duration max{std::chrono::seconds{30}};
+  /// Retries made before giving up.
+  unsigned max_attempts{6};
+};
+
+/// Delay before retrying an operation.
+///
+/// The delay doubles with each attempt, up to a maximum, and is randomly
+/// shortened by up to half so that devices failing together, such as the
+/// partitions of one disk, are not retried in lockstep.
+///
+/// @param attempt Number of retries already made.
+loop::Clock::duration Delay(const Backoff& backoff, unsigned attempt);
+
+}  // namespace retry
+
+#endif  // UDISKEN_RETRY_HPP_
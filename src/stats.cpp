@@ -0,0 +1,208 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Latency histograms and counters of the automount pipeline, readable over
+/// D-Bus from a running daemon.
+
+#include "stats.hpp"
+
+#include <sdbus-c++/Error.h>
+#include <sdbus-c++/Flags.h>
+#include <sdbus-c++/IConnection.h>
+#include <sdbus-c++/IObject.h>
+#include <sdbus-c++/Types.h>
+#include <sdbus-c++/VTableItems.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace stats {
+
+namespace {
+
+const sdbus::ServiceName kServiceName{"org.udisken"};
+const sdbus::ObjectPath kObjectPath{"/org/udisken/Stats"};
+constexpr auto kInterfaceName{"org.udisken.Stats"};
+
+constexpr std::array<std::string_view, kStages> kStageNames{
+    "interfaces_added", "proxy_construction", "automount_checks",
+    "mount_call",       "notify",
+};
+
+/// Count, p50, p90, p99 and maximum, in microseconds.
+using LatencySummary = sdbus::Struct<std::uint64_t, std::uint64_t,
+                                     std::uint64_t, std::uint64_t,
+                                     std::uint64_t>;
+
+std::map<std::string, LatencySummary> Latencies() {
+  std::map<std::string, LatencySummary> latencies{};
+  for (std::size_t stage{}; stage < kStages; ++stage) {
+    const auto summary{Global().latencies[stage].Summarize()};
+    latencies.emplace(kStageNames[stage],
+                      LatencySummary{summary.count, summary.p50_us,
+                                     summary.p90_us, summary.p99_us,
+                                     summary.max_us});
+  }
+
+  return latencies;
+}
+
+}  // namespace
+
+std::string_view Name(Stage stage) {
+  return kStageNames[static_cast<std::size_t>(stage)];
+}
+
+void Histogram::Record(Clock::duration latency) {
+  const auto us{static_cast<std::uint64_t>(std::max<std::int64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(latency).count(),
+      0))};
+  // Number of significant bits: 0 under 1 us, i under 2^i us.
+  const auto bits{static_cast<std::size_t>(
+      std::numeric_limits<std::uint64_t>::digits - std::countl_zero(us))};
+  const auto bucket{std::min(bits, kBuckets - 1)};
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+
+  auto max_us{max_us_.load(std::memory_order_relaxed)};
+  while (us > max_us && !max_us_.compare_exchange_weak(
+                            max_us, us, std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Summary Histogram::Summarize() const {
+  std::array<std::uint64_t, kBuckets> counts{};
+  Summary summary{.max_us = max_us_.load(std::memory_order_relaxed)};
+  for (std::size_t bucket{}; bucket < kBuckets; ++bucket) {
+    counts[bucket] = buckets_[bucket].load(std::memory_order_relaxed);
+    summary.count += counts[bucket];
+  }
+
+  // Nearest rank, as an upper bound.
+  const auto percentile{[&](std::uint64_t percent) -> std::uint64_t {
+    const std::uint64_t rank{(percent * summary.count + 99) / 100};
+    std::uint64_t seen{};
+    for (std::size_t bucket{}; bucket < kBuckets - 1; ++bucket) {
+      seen += counts[bucket];
+      if (seen >= rank) {
+        return std::min(std::uint64_t{1} << bucket, summary.max_us);
+      }
+    }
+
+    return summary.max_us;
+  }};
+  if (summary.count > 0) {
+    summary.p50_us = percentile(50);
+    summary.p90_us = percentile(90);
+    summary.p99_us = percentile(99);
+  }
+
+  return summary;
+}
+
+void Counters::Add(std::string_view label) {
+  label = label.substr(0, kMaxLabelSize);
+
+  for (auto& slot : slots_) {
+    auto state{slot.state.load(std::memory_order_acquire)};
+    if (state == kEmpty &&
+        slot.state.compare_exchange_strong(state, kClaimed,
+                                           std::memory_order_acquire)) {
+      std::ranges::copy(label, slot.label.begin());
+      slot.label_size = label.size();
+      slot.count.fetch_add(1, std::memory_order_relaxed);
+      slot.state.store(kReady, std::memory_order_release);
+
+      return;
+    }
+    // Another thread is labelling this slot, which only takes a copy.
+    while (state == kClaimed) {
+      state = slot.state.load(std::memory_order_acquire);
+    }
+    if (std::string_view{slot.label.data(), slot.label_size} == label) {
+      slot.count.fetch_add(1, std::memory_order_relaxed);
+
+      return;
+    }
+  }
+
+  other_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::map<std::string, std::uint64_t> Counters::Snapshot() const {
+  std::map<std::string, std::uint64_t> snapshot{};
+  for (const auto& slot : slots_) {
+    if (slot.state.load(std::memory_order_acquire) != kReady) {
+      continue;
+    }
+    snapshot.emplace(std::string{slot.label.data(), slot.label_size},
+                     slot.count.load(std::memory_order_relaxed));
+  }
+  if (const auto other{other_.load(std::memory_order_relaxed)}; other > 0) {
+    snapshot["other"] += other;
+  }
+
+  return snapshot;
+}
+
+Stats& Global() {
+  static Stats stats{};
+
+  return stats;
+}
+
+Service::Service(sdbus::IConnection& connection)
+    : object_{sdbus::createObject(connection, kObjectPath)} {
+  object_
+      ->addVTable(
+          sdbus::registerProperty("Mounts")
+              .withGetter([] {
+                return Global().mounts.load(std::memory_order_relaxed);
+              })
+              .withUpdateBehavior(sdbus::Flags::EMITS_NO_SIGNAL),
+          sdbus::registerProperty("Skips")
+              .withGetter([] { return Global().skips.Snapshot(); })
+              .withUpdateBehavior(sdbus::Flags::EMITS_NO_SIGNAL),
+          sdbus::registerProperty("Failures")
+              .withGetter([] { return Global().failures.Snapshot(); })
+              .withUpdateBehavior(sdbus::Flags::EMITS_NO_SIGNAL),
+          sdbus::registerProperty("Latencies")
+              .withGetter([] { return Latencies(); })
+              .withUpdateBehavior(sdbus::Flags::EMITS_NO_SIGNAL))
+      .forInterface(sdbus::InterfaceName{kInterfaceName});
+
+  try {
+    connection.requestName(kServiceName);
+  } catch (const sdbus::Error& e) {
+    spdlog::warn("Statistics only available at the unique bus name {}: {}",
+                 connection.getUniqueName().c_str(), e.what());
+  }
+}
+
+}  // namespace stats
@@ -0,0 +1,185 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Latency histograms and counters of the automount pipeline, readable over
+/// D-Bus from a running daemon.
+
+#ifndef UDISKEN_STATS_HPP_
+#define UDISKEN_STATS_HPP_
+
+#include <sdbus-c++/IConnection.h>
+#include <sdbus-c++/IObject.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/// Latency histograms and counters of the automount pipeline, readable over
+/// D-Bus from a running daemon.
+///
+/// Recording is lock-free, and cheap enough to stay enabled: any thread can
+/// record, such as pool::WorkerPool workers sending notifications.
+namespace stats {
+
+using Clock = std::chrono::steady_clock;
+
+/// Timed stages of the automount pipeline.
+enum class Stage : std::uint8_t {
+  /// Handling of a UDisks InterfacesAdded signal, from its receipt.
+  kInterfacesAdded,
+  /// Construction of the proxies of a new block device.
+  kProxyConstruction,
+  /// Checks deciding whether to automount a block device.
+  kAutomountChecks,
+  /// UDisks Filesystem.Mount call, until its reply.
+  kMountCall,
+  /// Sending a desktop notification, until the server's reply.
+  kNotify,
+};
+
+inline constexpr std::size_t kStages{5};
+
+/// Name of a stage, as exposed over D-Bus.
+std::string_view Name(Stage stage);
+
+/// Latency histogram with fixed, power-of-two buckets of microseconds.
+class Histogram {
+ public:
+  /// Bucket 0 counts latencies under 1 us; bucket i, those under 2^i us. The
+  /// last one counts everything longer.
+  static constexpr std::size_t kBuckets{32};
+
+  /// Summary of the recorded latencies, in microseconds. Percentiles are
+  /// upper bounds: the bound of the bucket holding them, or the maximum.
+  struct Summary {
+    std::uint64_t count{};
+    std::uint64_t p50_us{};
+    std::uint64_t p90_us{};
+    std::uint64_t p99_us{};
+    std::uint64_t max_us{};
+  };
+
+  void Record(Clock::duration latency);
+
+  Summary Summarize() const;
+
+ private:
+  std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+  std::atomic<std::uint64_t> max_us_{};
+};
+
+/// Counters by label, such as by error name.
+///
+/// Labels get a slot the first time they are counted, and keep it; labels
+/// beyond the slots are counted together, as "other".
+class Counters {
+ public:
+  static constexpr std::size_t kSlots{32};
+  /// Longer labels are truncated.
+  static constexpr std::size_t kMaxLabelSize{64};
+
+  void Add(std::string_view label);
+
+  std::map<std::string, std::uint64_t> Snapshot() const;
+
+ private:
+  enum State : std::uint8_t { kEmpty, kClaimed, kReady };
+
+  struct Slot {
+    /// The label is only read once kReady.
+    std::atomic<State> state{kEmpty};
+    std::array<char, kMaxLabelSize> label{};
+    std::size_t label_size{};
+    std::atomic<std::uint64_t> count{};
+  };
+
+  std::array<Slot, kSlots> slots_{};
+  std::atomic<std::uint64_t> other_{};
+};
+
+/// Statistics of the whole daemon.
+struct Stats {
+  std::array<Histogram, kStages> latencies{};
+  /// Filesystems automounted.
+  std::atomic<std::uint64_t> mounts{};
+  /// Block devices not automounted, by reason.
+  Counters skips{};
+  /// Failed mounts, by D-Bus error name.
+  Counters failures{};
+};
+
+/// Statistics of this process.
+Stats& Global();
+
+inline void Record(Stage stage, Clock::duration latency) {
+  Global().latencies[static_cast<std::size_t>(stage)].Record(latency);
+}
+
+/// Records the time spent in a scope.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Stage stage) : stage_{stage} {}
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer(ScopedTimer&&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+  ~ScopedTimer() noexcept { Record(stage_, Clock::now() - start_); }
+
+ private:
+  Stage stage_;
+  Clock::time_point start_{Clock::now()};
+};
+
+/// Exposes Global() read-only, as the org.udisken.Stats interface of
+/// /org/udisken/Stats:
+/// - Mounts (t): filesystems automounted;
+/// - Skips (a{st}): block devices not automounted, by reason;
+/// - Failures (a{st}): failed mounts, by D-Bus error name;
+/// - Latencies (a{s(ttttt)}): count, p50, p90, p99 and maximum latencies in
+///   microseconds, by stage.
+///
+/// Values are read when requested, and no change is signalled: poll them,
+/// such as with busctl --user get-property org.udisken /org/udisken/Stats
+/// org.udisken.Stats Latencies.
+class Service {
+ public:
+  /// Serves requests on the loop processing the connection; also requests
+  /// the org.udisken name, unless another instance owns it.
+  ///
+  /// @param connection Session bus connection; must outlive the service.
+  ///
+  /// @throws sdbus::Error Could not register the object.
+  explicit Service(sdbus::IConnection& connection);
+
+ private:
+  std::unique_ptr<sdbus::IObject> object_;
+};
+
+}  // namespace stats
+
+#endif  // UDISKEN_STATS_HPP_
@@ -0,0 +1,264 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Opt-in tracing of what UDISKEN does for each device, as Chrome trace
+/// events, viewable in Perfetto or chrome://tracing.
+
+#include "trace.hpp"
+
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace trace {
+
+namespace internal {
+
+std::atomic<bool> enabled{false};
+
+}  // namespace internal
+
+namespace {
+
+/// Spans per thread, before dropping them.
+constexpr std::size_t kBufferCapacity{1024};
+constexpr std::chrono::milliseconds kFlushInterval{500};
+/// Tracks of devices are numbered from here, above any thread ID (see
+/// PID_MAX_LIMIT).
+constexpr std::int32_t kFirstDeviceTrack{std::int32_t{1} << 22};
+
+/// Ring buffer of a thread, written by it alone, and read by the recorder.
+struct Buffer {
+  std::array<internal::Event, kBufferCapacity> events{};
+  /// Written spans; only ever grows.
+  std::atomic<std::size_t> head{};
+  /// Read spans; only ever grows.
+  std::atomic<std::size_t> tail{};
+  std::atomic<std::uint64_t> dropped{};
+};
+
+/// Buffers of every thread which ended a span, kept after threads exit until
+/// read.
+struct Buffers {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<Buffer>> buffers;
+};
+
+Buffers& AllBuffers() {
+  static Buffers buffers{};
+
+  return buffers;
+}
+
+Buffer& LocalBuffer() {
+  thread_local std::shared_ptr<Buffer> buffer{[] {
+    auto created{std::make_shared<Buffer>()};
+    auto& all{AllBuffers()};
+    const std::scoped_lock lock{all.mutex};
+    all.buffers.push_back(created);
+
+    return created;
+  }()};
+
+  return *buffer;
+}
+
+/// Microseconds, as Chrome trace events have them.
+std::string Microseconds(Clock::duration duration) {
+  const auto ns{
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()};
+
+  return std::format("{}.{:03}", ns / 1000, ns % 1000);
+}
+
+void AppendEscaped(std::string& out, std::string_view sv) {
+  for (const char c : sv) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      std::format_to(std::back_inserter(out), "\\u{:04x}",
+                     static_cast<unsigned>(c));
+    } else {
+      out.push_back(c);
+    }
+  }
+}
+
+}  // namespace
+
+namespace internal {
+
+void Begin(Event& event, const char* name, std::string_view object_path) {
+  thread_local const std::int32_t thread{gettid()};
+
+  object_path = object_path.substr(0, Event::kMaxPathSize);
+  event.name = name;
+  event.thread = thread;
+  event.path_size = static_cast<std::uint8_t>(object_path.size());
+  std::ranges::copy(object_path, event.path.begin());
+  // Last, not to time the above.
+  event.start = Clock::now();
+}
+
+void Push(const Event& event) {
+  auto& buffer{LocalBuffer()};
+  const auto head{buffer.head.load(std::memory_order_relaxed)};
+  if (head - buffer.tail.load(std::memory_order_acquire) == kBufferCapacity) {
+    buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+
+    return;
+  }
+
+  // Field by field, copying only the used part of the path.
+  auto& slot{buffer.events[head % kBufferCapacity]};
+  slot.name = event.name;
+  slot.start = event.start;
+  slot.duration = event.duration;
+  slot.thread = event.thread;
+  slot.path_size = event.path_size;
+  std::ranges::copy_n(event.path.begin(), event.path_size, slot.path.begin());
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+}  // namespace internal
+
+Recorder::Recorder(const std::filesystem::path& path)
+    : file_{path, std::ios::trunc}, pid_{getpid()} {
+  if (!file_) {
+    throw std::system_error{errno, std::generic_category(),
+                            "could not open trace file " + path.string()};
+  }
+
+  // The closing bracket is optional, should UDISKEN not exit cleanly.
+  file_ << std::format(
+      "[\n{{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":{},"
+      "\"args\":{{\"name\":\"udisken\"}}}}",
+      pid_);
+
+  internal::enabled.store(true, std::memory_order_relaxed);
+  flusher_ = std::jthread{[this](const std::stop_token& stop) { Run(stop); }};
+  spdlog::info("Tracing to {}", path.string());
+}
+
+Recorder::~Recorder() noexcept {
+  internal::enabled.store(false, std::memory_order_relaxed);
+  flusher_.request_stop();
+  flusher_.join();
+  Flush();
+  file_ << "\n]\n";
+  file_.flush();
+
+  std::uint64_t dropped{};
+  const std::scoped_lock lock{AllBuffers().mutex};
+  for (const auto& buffer : AllBuffers().buffers) {
+    dropped += buffer->dropped.load(std::memory_order_relaxed);
+  }
+  if (dropped > 0) {
+    spdlog::warn("Dropped {} trace spans: too many at once", dropped);
+  }
+}
+
+void Recorder::Run(const std::stop_token& stop) {
+  while (!stop.stop_requested()) {
+    {
+      std::unique_lock lock{mutex_};
+      wakeup_.wait_for(lock, stop, kFlushInterval, [] { return false; });
+    }
+    Flush();
+  }
+}
+
+void Recorder::Flush() {
+  // Copied, not to hold the lock while writing: threads starting wait on it.
+  std::vector<std::shared_ptr<Buffer>> buffers{};
+  {
+    const std::scoped_lock lock{AllBuffers().mutex};
+    buffers = AllBuffers().buffers;
+  }
+
+  for (const auto& buffer : buffers) {
+    auto tail{buffer->tail.load(std::memory_order_relaxed)};
+    const auto head{buffer->head.load(std::memory_order_acquire)};
+    for (; tail != head; ++tail) {
+      Write(buffer->events[tail % kBufferCapacity]);
+    }
+    buffer->tail.store(tail, std::memory_order_release);
+  }
+  file_.flush();
+}
+
+void Recorder::Write(const internal::Event& event) {
+  const std::string_view path{event.path.data(), event.path_size};
+  const std::int32_t track{path.empty() ? event.thread : Track(path)};
+
+  line_.clear();
+  std::format_to(std::back_inserter(line_),
+                 ",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":{},\"tid\":{},"
+                 "\"ts\":{},\"dur\":{}",
+                 event.name, pid_, track,
+                 Microseconds(event.start.time_since_epoch()),
+                 Microseconds(event.duration));
+  if (!path.empty()) {
+    line_.append(",\"args\":{\"object_path\":\"");
+    AppendEscaped(line_, path);
+    line_.append("\"}");
+  }
+  line_.push_back('}');
+  file_ << line_;
+}
+
+std::int32_t Recorder::Track(std::string_view object_path) {
+  const auto [it, inserted]{tracks_.try_emplace(
+      std::string{object_path},
+      kFirstDeviceTrack + static_cast<std::int32_t>(tracks_.size()))};
+  if (inserted) {
+    line_.clear();
+    std::format_to(std::back_inserter(line_),
+                   ",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},"
+                   "\"tid\":{},\"args\":{{\"name\":\"",
+                   pid_, it->second);
+    AppendEscaped(line_, object_path);
+    line_.append("\"}}");
+    file_ << line_;
+  }
+
+  return it->second;
+}
+
+}  // namespace trace
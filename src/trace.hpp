@@ -0,0 +1,160 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Opt-in tracing of what UDISKEN does for each device, as Chrome trace
+/// events, viewable in Perfetto or chrome://tracing.
+
+#ifndef UDISKEN_TRACE_HPP_
+#define UDISKEN_TRACE_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+/// Opt-in tracing of what UDISKEN does for each device, as Chrome trace
+/// events, viewable in Perfetto or chrome://tracing.
+///
+/// Spans are copied into a ring buffer of the thread ending them, preallocated
+/// on its first span, and written to the file by a background thread. A full
+/// buffer drops spans rather than waiting. While no Recorder runs, a span
+/// costs one relaxed atomic load.
+namespace trace {
+
+using Clock = std::chrono::steady_clock;
+
+namespace internal {
+
+/// Whether a Recorder runs.
+extern std::atomic<bool> enabled;
+
+/// Span, as copied into ring buffers.
+struct Event {
+  /// Longer object paths are truncated.
+  static constexpr std::size_t kMaxPathSize{96};
+
+  /// Static string.
+  const char* name{};
+  Clock::time_point start{};
+  Clock::duration duration{};
+  /// Thread which began the span, for spans of no device.
+  std::int32_t thread{};
+  std::uint8_t path_size{};
+  /// Only the first path_size characters are copied around.
+  std::array<char, kMaxPathSize> path{};
+};
+
+/// Begin recording the event.
+void Begin(Event& event, const char* name, std::string_view object_path);
+
+/// Copy the event into the ring buffer of this thread.
+void Push(const Event& event);
+
+}  // namespace internal
+
+/// Whether spans are recorded.
+inline bool Enabled() {
+  return internal::enabled.load(std::memory_order_relaxed);
+}
+
+/// Records the time spent in a scope, including in coroutines suspended
+/// within it.
+///
+/// Spans of a device are displayed on its own track, named after its object
+/// path; spans of no device, on the track of the thread which began them.
+class Span {
+ public:
+  /// @param name Static string, such as "Mount".
+  /// @param object_path UDisks object path of the device; empty if none.
+  explicit Span(const char* name, std::string_view object_path = {}) {
+    if (Enabled()) {
+      internal::Begin(event_, name, object_path);
+    }
+  }
+
+  Span(const Span&) = delete;
+  Span(Span&&) = delete;
+  Span& operator=(const Span&) = delete;
+  Span& operator=(Span&&) = delete;
+
+  ~Span() noexcept {
+    if (event_.name != nullptr) {
+      event_.duration = Clock::now() - event_.start;
+      internal::Push(event_);
+    }
+  }
+
+ private:
+  internal::Event event_;
+};
+
+/// Writes spans to a file for as long as it lives. Only one may exist at a
+/// time.
+///
+/// As a background thread is started, construct it after blocking signals
+/// (see loop::MainLoop::QuitOnSignals).
+class Recorder {
+ public:
+  /// @param path File to write, replaced if it exists.
+  ///
+  /// @throws std::system_error Could not open the file.
+  explicit Recorder(const std::filesystem::path& path);
+
+  Recorder(const Recorder&) = delete;
+  Recorder(Recorder&&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+  Recorder& operator=(Recorder&&) = delete;
+
+  /// Writes the remaining spans, and completes the file.
+  ~Recorder() noexcept;
+
+ private:
+  void Run(const std::stop_token& stop);
+  /// Write the spans of every ring buffer.
+  void Flush();
+  void Write(const internal::Event& event);
+  /// Track of a device, named once first used.
+  std::int32_t Track(std::string_view object_path);
+
+  std::ofstream file_;
+  std::int32_t pid_;
+  /// Only used by the background thread, then by the destructor.
+  std::unordered_map<std::string, std::int32_t> tracks_{};
+  std::string line_{};
+
+  std::mutex mutex_{};
+  std::condition_variable_any wakeup_{};
+  /// Last: started once the rest is ready.
+  std::jthread flusher_{};
+};
+
+}  // namespace trace
+
+#endif  // UDISKEN_TRACE_HPP_
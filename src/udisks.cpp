@@ -23,8 +23,15 @@
 
 #include "udisks.hpp"
 
+#include "arena.hpp"
+#include "coro.hpp"
+#include "logging.hpp"
 #include "mount.hpp"
-#include "options.hpp"
+#include "record.hpp"
+#include "registry.hpp"
+#include "retry.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 
 #include <sdbus-c++/Error.h>
 #include <sdbus-c++/IConnection.h>
@@ -33,14 +40,145 @@
 #include <spdlog/spdlog.h>
 #include <udisks-sdbus-cpp/udisks_errors.hpp>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 namespace objects {
 
+namespace {
+
+/// Returns a function updating one cached property, from its name and a
+/// pointer to the member caching it. The function returns whether the cached
+/// value changed.
+///
+/// UDisks sends the new value of every changed property. Should a property
+/// only be invalidated, forget its value rather than fetching it again.
+template <class Properties, class Changed>
+auto PropertyUpdater(Properties& properties, const Changed& changed,
+                     std::span<const sdbus::PropertyName> invalidated) {
+  return [&properties, &changed, invalidated]<typename T>(
+             T Properties::* member, const char* name) {
+    const sdbus::PropertyName property{name};
+    T value{};
+    if (const auto it{changed.find(property)};
+        it != changed.end() && it->second.template containsValueOfType<T>()) {
+      value = it->second.template get<T>();
+    } else if (std::ranges::contains(invalidated, property)) {
+      value = Properties{}.*member;
+    } else {
+      return false;
+    }
+
+    if (properties.*member == value) {
+      return false;
+    }
+    properties.*member = std::move(value);
+
+    return true;
+  };
+}
+
+}  // namespace
+
+std::string_view ViewByteString(const std::vector<std::uint8_t>& bytes) {
+  std::string_view view{reinterpret_cast<const char*>(bytes.data()),
+                        bytes.size()};
+  if (view.ends_with('\0')) {
+    view.remove_suffix(1);
+  }
+
+  return view;
+}
+
+template <class Changed>
+bool BlockProperties::Update(
+    const sdbus::InterfaceName& interface, const Changed& changed,
+    std::span<const sdbus::PropertyName> invalidated) {
+  const auto update{PropertyUpdater(*this, changed, invalidated)};
+
+  if (interface == udisks_sd::proxy_wrappers::UdisksBlock::INTERFACE_NAME) {
+    update(&BlockProperties::drive, "Drive");
+    const bool hint_auto_changed{
+        update(&BlockProperties::hint_auto, "HintAuto")};
+    const bool hint_ignore_changed{
+        update(&BlockProperties::hint_ignore, "HintIgnore")};
+    const bool hint_system_changed{
+        update(&BlockProperties::hint_system, "HintSystem")};
+    // Read-only loop devices are rejected.
+    const bool read_only_changed{
+        update(&BlockProperties::read_only, "ReadOnly")};
+    update(&BlockProperties::hint_name, "HintName");
+    update(&BlockProperties::hint_icon_name, "HintIconName");
+    update(&BlockProperties::id_label, "IdLabel");
+    update(&BlockProperties::id_uuid, "IdUUID");
+    update(&BlockProperties::id_type, "IdType");
+    // Set once media, such as a disc, is inserted and probed.
+    const bool id_usage_changed{update(&BlockProperties::id_usage, "IdUsage")};
+
+    return hint_auto_changed || hint_ignore_changed || hint_system_changed ||
+           read_only_changed || id_usage_changed;
+  }
+  if (interface ==
+      udisks_sd::proxy_wrappers::UdisksFilesystem::INTERFACE_NAME) {
+    // Not relevant to automounting: a filesystem unmounted by the user must
+    // stay unmounted.
+    update(&BlockProperties::mount_points, "MountPoints");
+  } else if (interface ==
+             udisks_sd::proxy_wrappers::UdisksLoop::INTERFACE_NAME) {
+    loop = true;
+    // Loop devices of package images are rejected.
+    return update(&BlockProperties::loop_backing_file, "BackingFile");
+  }
+
+  return false;
+}
+
+template bool BlockProperties::Update(const sdbus::InterfaceName&,
+                                      const PropertyMap&,
+                                      std::span<const sdbus::PropertyName>);
+template bool BlockProperties::Update(const sdbus::InterfaceName&,
+                                      const ChangedProperties&,
+                                      std::span<const sdbus::PropertyName>);
+
+template <class Changed>
+bool DriveProperties::Update(
+    const sdbus::InterfaceName& interface, const Changed& changed,
+    std::span<const sdbus::PropertyName> invalidated) {
+  const auto update{PropertyUpdater(*this, changed, invalidated)};
+
+  if (interface != udisks_sd::proxy_wrappers::UdisksDrive::INTERFACE_NAME) {
+    return false;
+  }
+  update(&DriveProperties::model, "Model");
+  update(&DriveProperties::vendor, "Vendor");
+  update(&DriveProperties::serial, "Serial");
+  update(&DriveProperties::removable, "Removable");
+  update(&DriveProperties::ejectable, "Ejectable");
+  update(&DriveProperties::connection_bus, "ConnectionBus");
+  update(&DriveProperties::rotation_rate, "RotationRate");
+
+  return update(&DriveProperties::media_available, "MediaAvailable");
+}
+
+template bool DriveProperties::Update(const sdbus::InterfaceName&,
+                                      const PropertyMap&,
+                                      std::span<const sdbus::PropertyName>);
+template bool DriveProperties::Update(const sdbus::InterfaceName&,
+                                      const ChangedProperties&,
+                                      std::span<const sdbus::PropertyName>);
+
 Drive::Drive(std::unique_ptr<udisks_sd::proxy_wrappers::UdisksDrive> drive)
     : drive_{std::move(drive)} {
   if (!drive_) {
@@ -56,30 +194,105 @@ auto Drive::GetDrive() -> udisks_sd::proxy_wrappers::UdisksDrive& {
   return *drive_;
 }
 
+std::shared_ptr<Drive> DriveCache::Get(const sdbus::ObjectPath& object_path) {
+  auto& cached{drives_[object_path]};
+  if (auto drive{cached.lock()}) {
+    return drive;
+  }
+
+  auto drive{std::make_shared<Drive>(
+      std::make_unique<udisks_sd::proxy_wrappers::UdisksDrive>(*connection_,
+                                                               object_path))};
+  cached = drive;
+
+  return drive;
+}
+
 BlockDevice::BlockDevice(
     std::unique_ptr<udisks_sd::proxy_wrappers::UdisksBlock> block,
+    BlockProperties properties, DriveCache* drive_cache,
     std::unique_ptr<udisks_sd::proxy_wrappers::UdisksFilesystem> filesystem,
     std::unique_ptr<udisks_sd::proxy_wrappers::UdisksLoop> loop,
     std::unique_ptr<udisks_sd::proxy_wrappers::UdisksPartition> partition)
-    : block_{std::move(block)},
+    : drive_cache_{drive_cache},
+      properties_{std::move(properties)},
+      block_{std::move(block)},
       filesystem_{std::move(filesystem)},
       loop_{std::move(loop)},
       partition_{std::move(partition)} {
   if (!block_) {
     throw std::invalid_argument("block pointer must not be null");
   }
+}
 
-  if (block_->Drive() != udisks::kEmptyObjectPath) {
-    drive_ = std::make_unique<Drive>(
-        std::make_unique<udisks_sd::proxy_wrappers::UdisksDrive>(
-            block_->getProxy().getConnection(), block_->Drive()));
+bool BlockDevice::AddInterfaces(const InterfaceMap& interfaces) {
+  auto& connection{block_->getProxy().getConnection()};
+  bool automount_relevant{false};
+
+  for (const auto& [interface, properties] : interfaces) {
+    if (interface ==
+            udisks_sd::proxy_wrappers::UdisksFilesystem::INTERFACE_NAME &&
+        !filesystem_) {
+      filesystem_ =
+          std::make_unique<udisks_sd::proxy_wrappers::UdisksFilesystem>(
+              connection, ObjectPath());
+      automount_relevant = true;
+    } else if (interface ==
+                   udisks_sd::proxy_wrappers::UdisksLoop::INTERFACE_NAME &&
+               !loop_) {
+      loop_ = std::make_unique<udisks_sd::proxy_wrappers::UdisksLoop>(
+          connection, ObjectPath());
+    } else if (interface ==
+                   udisks_sd::proxy_wrappers::UdisksPartition::INTERFACE_NAME &&
+               !partition_) {
+      partition_ =
+          std::make_unique<udisks_sd::proxy_wrappers::UdisksPartition>(
+              connection, ObjectPath());
+    }
+
+    if (properties_.Update(interface, properties)) {
+      automount_relevant = true;
+    }
   }
+
+  return automount_relevant;
 }
 
 const sdbus::ObjectPath& BlockDevice::ObjectPath() const {
   return block_->getProxy().getObjectPath();
 }
 
+void BlockDevice::RemoveInterface(const sdbus::InterfaceName& interface) {
+  if (interface ==
+      udisks_sd::proxy_wrappers::UdisksFilesystem::INTERFACE_NAME) {
+    // Cancels automounting, and its mount call, before the proxy goes.
+    automount_ = {};
+    filesystem_ = nullptr;
+    properties_.mount_points.clear();
+  } else if (interface ==
+             udisks_sd::proxy_wrappers::UdisksLoop::INTERFACE_NAME) {
+    loop_ = nullptr;
+    properties_.loop = false;
+    properties_.loop_backing_file.clear();
+  } else if (interface ==
+             udisks_sd::proxy_wrappers::UdisksPartition::INTERFACE_NAME) {
+    partition_ = nullptr;
+  }
+}
+
+Drive* BlockDevice::GetDrive() {
+  // The Drive property may have changed since the drive was accessed.
+  if (drive_ && drive_->ObjectPath() != properties_.drive) {
+    drive_ = nullptr;
+  }
+  if (!drive_ && drive_cache_ != nullptr &&
+      properties_.drive != udisks::kEmptyObjectPath) {
+    drive_ = drive_cache_->Get(properties_.drive);
+  }
+
+  return drive_.get();
+}
+
 auto BlockDevice::Filesystem() -> udisks_sd::proxy_wrappers::UdisksFilesystem& {
   if (!HasFilesystem()) {
     throw std::logic_error("object does not implement interface");
@@ -108,6 +321,38 @@ auto BlockDevice::Partition() -> udisks_sd::proxy_wrappers::UdisksPartition& {
 
 namespace managers {
 
+namespace {
+
+/// Backoff of mounts which failed transiently, such as when the device was
+/// busy.
+constexpr retry::Backoff kMountBackoff{};
+
+/// Match rules for property changes of UDisks block devices and drives.
+///
+/// Registered once on the connection, and filtered by the bus on the
+/// interface (arg0) so that only interfaces whose properties are cached wake
+/// UDISKEN up: Partition, Job, etc. changes are never delivered.
+constexpr std::array kPropertiesChangedMatches{
+    "type='signal',sender='org.freedesktop.UDisks2',"
+    "interface='org.freedesktop.DBus.Properties',member='PropertiesChanged',"
+    "path_namespace='/org/freedesktop/UDisks2/block_devices',"
+    "arg0='org.freedesktop.UDisks2.Block'",
+    "type='signal',sender='org.freedesktop.UDisks2',"
+    "interface='org.freedesktop.DBus.Properties',member='PropertiesChanged',"
+    "path_namespace='/org/freedesktop/UDisks2/block_devices',"
+    "arg0='org.freedesktop.UDisks2.Filesystem'",
+    "type='signal',sender='org.freedesktop.UDisks2',"
+    "interface='org.freedesktop.DBus.Properties',member='PropertiesChanged',"
+    "path_namespace='/org/freedesktop/UDisks2/block_devices',"
+    "arg0='org.freedesktop.UDisks2.Loop'",
+    "type='signal',sender='org.freedesktop.UDisks2',"
+    "interface='org.freedesktop.DBus.Properties',member='PropertiesChanged',"
+    "path_namespace='/org/freedesktop/UDisks2/drives',"
+    "arg0='org.freedesktop.UDisks2.Drive'",
+};
+
+}  // namespace
+
 UdisksManager::UdisksManager(sdbus::IConnection& connection)
     : ProxyInterfaces(connection, sdbus::ServiceName{udisks::kInterfaceName},
                       sdbus::ObjectPath{kObjectPath}) {
@@ -115,75 +360,445 @@ UdisksManager::UdisksManager(sdbus::IConnection& connection)
 }
 
 UdisksObjectManager::UdisksObjectManager(sdbus::IConnection& connection,
-                                         options::Options options)
+                                         mount::Context context)
     : ProxyInterfaces(connection, sdbus::ServiceName{udisks::kInterfaceName},
                       sdbus::ObjectPath{udisks::kObjectPath}),
-      options_{options} {
+      context_{context},
+      drive_cache_{connection},
+      registry_{std::make_unique<registry::DeviceRegistry>()} {
+  for (const auto* match : kPropertiesChangedMatches) {
+    properties_changed_slots_.push_back(connection.addMatch(
+        match,
+        [this](sdbus::Message msg) { OnPropertiesChanged(std::move(msg)); },
+        sdbus::return_slot));
+  }
+
   for (auto managed_objects{GetManagedObjects()};
        const auto& [object_path, interfaces_and_properties] : managed_objects) {
+    if (context_.recorder != nullptr) {
+      context_.recorder->ManagedObject(object_path, interfaces_and_properties);
+    }
     onInterfacesAdded(object_path, interfaces_and_properties);
   }
+  scanning_ = false;
 
   spdlog::info("Scanned drives");
 
+  AutomountScanned();
+
   registerProxy();
 }
 
-namespace {
-
-template <class UdisksInterface>
-bool HasInterface(InterfacesAndProperties& inp) {
-  return inp.contains(sdbus::InterfaceName{UdisksInterface::INTERFACE_NAME});
-}
+UdisksObjectManager::~UdisksObjectManager() noexcept {
+  if (throttle_timer_) {
+    context_.loop->Remove(*throttle_timer_);
+  }
 
+  unregisterProxy();
 }
 
 void UdisksObjectManager::onInterfacesAdded(
     const sdbus::ObjectPath& object_path,
     InterfacesAndProperties interfaces_and_properties) {
-  spdlog::debug("New object: {}", object_path.c_str());
+  const stats::ScopedTimer timer{stats::Stage::kInterfacesAdded};
+  const trace::Span span{"InterfacesAdded", object_path};
+  SPDLOG_DEBUG("New object: {}", object_path.c_str());
+  // Objects of the initial scan were recorded as such.
+  if (context_.recorder != nullptr && !scanning_) {
+    context_.recorder->InterfacesAdded(object_path, interfaces_and_properties);
+  }
 
-  if (!HasInterface<udisks_sd::proxy_wrappers::UdisksBlock>(
+  if (HasInterface<udisks_sd::proxy_wrappers::UdisksDrive>(
           interfaces_and_properties)) {
+    objects::DriveProperties properties{};
+    for (const auto& [interface, changed] : interfaces_and_properties) {
+      properties.Update(interface, changed);
+    }
+    registry_->drives.InsertOrAssign(object_path, std::move(properties));
+
+    // Block devices announced before their drive, as listed by
+    // GetManagedObjects, were judged without its properties: the policy may
+    // allow them, by drive model or serial.
+    if (context_.config != nullptr &&
+        context_.config->Get().policy.Size() > 0) {
+      // Copied out, as reconsidering them changes the registry. The vector is
+      // on the arena, but the paths are too long for the small string buffer.
+      arena::EventArena arena{};
+      std::pmr::vector<sdbus::ObjectPath> on_drive{arena.Resource()};
+      for (const auto& [blk_path, rejected] :
+           registry_->rejected_block_devices) {
+        if (rejected.properties.drive == object_path) {
+          on_drive.push_back(blk_path);
+        }
+      }
+      for (const auto& blk_path : on_drive) {
+        Reconsider(blk_path);
+      }
+    }
+
     return;
   }
 
-  auto block{std::make_unique<udisks_sd::proxy_wrappers::UdisksBlock>(
-      getProxy().getConnection(), object_path)};
+  // Interfaces added to a block device we already know of.
+  if (auto* const blk_device{registry_->block_devices.Find(object_path)}) {
+    const sdbus::ObjectPath old_drive{blk_device->Properties().drive};
+    const bool automount_relevant{
+        blk_device->AddInterfaces(interfaces_and_properties)};
+    UpdateDriveOf(object_path, old_drive, blk_device->Properties().drive);
+    if (automount_relevant) {
+      Automount(object_path, *blk_device);
+    }
 
-  std::unique_ptr<udisks_sd::proxy_wrappers::UdisksFilesystem> filesystem{};
-  if (HasInterface<udisks_sd::proxy_wrappers::UdisksFilesystem>(
-          interfaces_and_properties)) {
-    filesystem = std::make_unique<udisks_sd::proxy_wrappers::UdisksFilesystem>(
-        getProxy().getConnection(), object_path);
+    return;
   }
 
-  std::unique_ptr<udisks_sd::proxy_wrappers::UdisksLoop> loop{};
-  if (HasInterface<udisks_sd::proxy_wrappers::UdisksLoop>(
-          interfaces_and_properties)) {
-    loop = std::make_unique<udisks_sd::proxy_wrappers::UdisksLoop>(
-        getProxy().getConnection(), object_path);
+  if (auto* const rejected{
+          registry_->rejected_block_devices.Find(object_path)}) {
+    for (const auto& [interface, changed] : interfaces_and_properties) {
+      rejected->properties.Update(interface, changed);
+      if (!std::ranges::contains(rejected->interfaces, interface)) {
+        rejected->interfaces.push_back(interface);
+      }
+    }
+    Reconsider(object_path);
+
+    return;
   }
 
-  std::unique_ptr<udisks_sd::proxy_wrappers::UdisksPartition> partition{};
-  if (HasInterface<udisks_sd::proxy_wrappers::UdisksPartition>(
+  if (!HasInterface<udisks_sd::proxy_wrappers::UdisksBlock>(
           interfaces_and_properties)) {
-    partition = std::make_unique<udisks_sd::proxy_wrappers::UdisksPartition>(
-        getProxy().getConnection(), object_path);
+    return;
   }
 
-  // Only block must be non-null. The rest can be null. The Drive member will be
-  // automatically constructed if it exists.
-  objects::BlockDevice blk_device{std::move(block), std::move(filesystem),
-                                  std::move(loop), std::move(partition)};
+  // Decided from the signal alone, before creating any proxy: most block
+  // devices announced at once, such as the loop devices of snaps, are never
+  // automounted.
+  registry::RejectedBlockDevice candidate{};
+  for (const auto& [interface, changed] : interfaces_and_properties) {
+    candidate.properties.Update(interface, changed);
+    candidate.interfaces.push_back(interface);
+  }
+  if (const auto reason{mount::RejectReason(
+          candidate.properties, Decide(candidate.properties))}) {
+    logging::Debug({.object_path = object_path}, "Not automounting {}: {}",
+                   object_path.c_str(), *reason);
+    stats::Global().skips.Add(*reason);
+    registry_->rejected_block_devices.InsertOrAssign(object_path,
+                                                     std::move(candidate));
 
-  mount::TryAutomount(blk_device);
+    return;
+  }
+
+  AddBlockDevice(object_path, std::move(candidate.properties),
+                 interfaces_and_properties);
+}
 
-  spdlog::debug("Processed block device at {}", object_path.c_str());
+void UdisksObjectManager::AddBlockDevice(
+    const sdbus::ObjectPath& object_path, objects::BlockProperties properties,
+    const objects::InterfaceMap& interfaces) {
+  const auto start{stats::Clock::now()};
+  // Blocks on the bus: the generated proxies register their signals with
+  // synchronous AddMatch calls, which the worker pool cannot take over as
+  // they are bound to this connection. Rejecting devices early, and creating
+  // drive proxies lazily, keeps these to the devices that may be mounted.
+  // Only block must be non-null; the other interfaces are merged right after.
+  auto& blk_device{registry_->block_devices.InsertOrAssign(
+      object_path,
+      objects::BlockDevice{
+          std::make_unique<udisks_sd::proxy_wrappers::UdisksBlock>(
+              getProxy().getConnection(), object_path),
+          std::move(properties), &drive_cache_})};
+  blk_device.AddInterfaces(interfaces);
+  stats::Record(stats::Stage::kProxyConstruction, stats::Clock::now() - start);
+  registry_->AddToDrive(blk_device.Properties().drive, object_path);
+
+  Automount(object_path, blk_device);
+
+  SPDLOG_DEBUG("Processed block device at {}", object_path.c_str());
+}
+
+void UdisksObjectManager::Reconsider(const sdbus::ObjectPath& object_path) {
+  auto* const rejected{registry_->rejected_block_devices.Find(object_path)};
+  if (rejected == nullptr ||
+      mount::RejectReason(rejected->properties,
+                          Decide(rejected->properties))) {
+    return;
+  }
+
+  auto accepted{std::move(*rejected)};
+  registry_->rejected_block_devices.Erase(object_path);
+
+  // Properties are cached already: only the proxies are missing.
+  objects::InterfaceMap interfaces{};
+  for (auto& interface : accepted.interfaces) {
+    interfaces.emplace(std::move(interface), objects::PropertyMap{});
+  }
+  AddBlockDevice(object_path, std::move(accepted.properties), interfaces);
+}
+
+policy::Decision UdisksObjectManager::Decide(
+    const objects::BlockProperties& blk) const {
+  return mount::Decide(context_, blk, registry_->drives.Find(blk.drive));
 }
 
 void UdisksObjectManager::onInterfacesRemoved(
-    [[maybe_unused]] const sdbus::ObjectPath& object_path,
-    [[maybe_unused]] const std::vector<sdbus::InterfaceName>& interfaces) {}
+    const sdbus::ObjectPath& object_path,
+    const std::vector<sdbus::InterfaceName>& interfaces) {
+  SPDLOG_DEBUG("Removed interfaces from object: {}", object_path.c_str());
+  if (context_.recorder != nullptr) {
+    context_.recorder->InterfacesRemoved(object_path, interfaces);
+  }
+
+  if (HasInterface<udisks_sd::proxy_wrappers::UdisksDrive>(interfaces)) {
+    registry_->drives.Erase(object_path);
+    drive_cache_.Forget(object_path);
+
+    return;
+  }
+
+  if (HasInterface<udisks_sd::proxy_wrappers::UdisksBlock>(interfaces)) {
+    if (const auto* const blk_device{
+            registry_->block_devices.Find(object_path)}) {
+      registry_->RemoveFromDrive(blk_device->Properties().drive, object_path);
+    }
+    registry_->block_devices.Erase(object_path);
+    registry_->rejected_block_devices.Erase(object_path);
+    registry_->mount_points.Erase(object_path);
+
+    return;
+  }
+
+  if (auto* const rejected{
+          registry_->rejected_block_devices.Find(object_path)}) {
+    for (const auto& interface : interfaces) {
+      std::erase(rejected->interfaces, interface);
+    }
+    if (HasInterface<udisks_sd::proxy_wrappers::UdisksFilesystem>(
+            interfaces)) {
+      rejected->properties.mount_points.clear();
+    }
+
+    return;
+  }
+
+  auto* const blk_device{registry_->block_devices.Find(object_path)};
+  if (blk_device == nullptr) {
+    return;
+  }
+  for (const auto& interface : interfaces) {
+    blk_device->RemoveInterface(interface);
+  }
+  if (HasInterface<udisks_sd::proxy_wrappers::UdisksFilesystem>(interfaces)) {
+    registry_->mount_points.Erase(object_path);
+  }
+}
+
+void UdisksObjectManager::OnPropertiesChanged(sdbus::Message msg) {
+  const sdbus::ObjectPath object_path{msg.getPath()};
+  auto* const blk_device{registry_->block_devices.Find(object_path)};
+  auto* const drive{blk_device == nullptr
+                        ? registry_->drives.Find(object_path)
+                        : nullptr};
+  auto* const rejected{blk_device == nullptr && drive == nullptr
+                           ? registry_->rejected_block_devices.Find(object_path)
+                           : nullptr};
+  if (blk_device == nullptr && drive == nullptr && rejected == nullptr) {
+    return;
+  }
+
+  // The signal is only needed until handled: read its containers into an
+  // arena.
+  arena::EventArena arena{};
+  sdbus::InterfaceName interface{};
+  objects::ChangedProperties changed{arena.Resource()};
+  std::pmr::vector<sdbus::PropertyName> invalidated{arena.Resource()};
+  msg >> interface >> changed >> invalidated;
+  // Only changes to known objects are recorded: the others are ignored.
+  if (context_.recorder != nullptr) {
+    context_.recorder->PropertiesChanged(object_path, interface, changed,
+                                         invalidated);
+  }
+
+  if (rejected != nullptr) {
+    if (rejected->properties.Update(interface, changed, invalidated)) {
+      Reconsider(object_path);
+    }
+
+    return;
+  }
+
+  if (drive != nullptr) {
+    // Media inserted in an existing drive, such as a disc in an optical
+    // drive, produces no InterfacesAdded: automount its block devices here.
+    if (drive->Update(interface, changed, invalidated) &&
+        drive->media_available) {
+      if (const auto* const members{
+              registry_->drive_block_devices.Find(object_path)}) {
+        for (const auto& blk_path : *members) {
+          if (auto* const blk{registry_->block_devices.Find(blk_path)}) {
+            Automount(blk_path, *blk);
+          }
+        }
+      }
+    }
+
+    return;
+  }
+
+  const sdbus::ObjectPath old_drive{blk_device->Properties().drive};
+  const bool automount_relevant{
+      blk_device->UpdateProperties(interface, changed, invalidated)};
+  UpdateDriveOf(object_path, old_drive, blk_device->Properties().drive);
+  // Unmounted, by UDISKEN or someone else.
+  if (blk_device->Properties().mount_points.empty()) {
+    registry_->mount_points.Erase(object_path);
+  }
+
+  if (automount_relevant) {
+    Automount(object_path, *blk_device);
+  }
+}
+
+bool UdisksObjectManager::Automount(const sdbus::ObjectPath& object_path,
+                                    objects::BlockDevice& blk_device) {
+  if (scanning_) {
+    return false;
+  }
+  {
+    const stats::ScopedTimer timer{stats::Stage::kAutomountChecks};
+    if (!mount::ShouldAutomount(blk_device,
+                                Decide(blk_device.Properties()))) {
+      return false;
+    }
+    if (blk_device.MountPending()) {
+      logging::Debug({.object_path = object_path},
+                     "Not automounting {}: already being mounted",
+                     object_path.c_str());
+      if (blk_device.NoteSkip("already being mounted")) {
+        stats::Global().skips.Add("already being mounted");
+      }
+
+      return false;
+    }
+  }
+
+  const auto* const drive{
+      registry_->drives.Find(blk_device.Properties().drive)};
+  if ((drive == nullptr || !drive->removable) && context_.loop != nullptr &&
+      context_.throttle_interval > std::chrono::milliseconds::zero()) {
+    Throttle(object_path);
+
+    return false;
+  }
+
+  blk_device.StartAutomount(AutomountTask(object_path));
+
+  return true;
+}
+
+void UdisksObjectManager::Throttle(const sdbus::ObjectPath& object_path) {
+  if (!std::ranges::contains(throttled_, object_path)) {
+    throttled_.push_back(object_path);
+  }
+  if (!throttle_timer_) {
+    StartThrottled();
+  }
+}
+
+void UdisksObjectManager::StartThrottled() {
+  throttle_timer_.reset();
+
+  while (!throttled_.empty()) {
+    const sdbus::ObjectPath object_path{std::move(throttled_.front())};
+    throttled_.pop_front();
+
+    // Removed, changed or mounted while waiting.
+    auto* const blk_device{registry_->block_devices.Find(object_path)};
+    if (blk_device == nullptr || blk_device->MountPending() ||
+        !mount::ShouldAutomount(*blk_device,
+                                Decide(blk_device->Properties()))) {
+      continue;
+    }
+
+    blk_device->StartAutomount(AutomountTask(object_path));
+    throttle_timer_ = context_.loop->AddTimer(context_.throttle_interval,
+                                              [this] { StartThrottled(); });
+
+    return;
+  }
+}
+
+void UdisksObjectManager::AutomountScanned() {
+  // Each mount runs until it waits for UDisks, so those of removable drives
+  // are all in flight at once, and the partitions of a disk are notified
+  // together. The others are throttled.
+  for (const auto& [drive, members] : registry_->drive_block_devices) {
+    for (const auto& blk_path : members) {
+      if (auto* const blk_device{registry_->block_devices.Find(blk_path)}) {
+        Automount(blk_path, *blk_device);
+      }
+    }
+  }
+
+  // Block devices without drive, such as loop devices.
+  for (auto& [blk_path, blk_device] : registry_->block_devices) {
+    if (blk_device.Properties().drive == udisks::kEmptyObjectPath) {
+      Automount(blk_path, blk_device);
+    }
+  }
+}
+
+void UdisksObjectManager::UpdateDriveOf(const sdbus::ObjectPath& object_path,
+                                        const sdbus::ObjectPath& old_drive,
+                                        const sdbus::ObjectPath& new_drive) {
+  if (old_drive == new_drive) {
+    return;
+  }
+
+  registry_->RemoveFromDrive(old_drive, object_path);
+  registry_->AddToDrive(new_drive, object_path);
+}
+
+auto UdisksObjectManager::AutomountTask(sdbus::ObjectPath object_path)
+    -> coro::Task<> {
+  for (unsigned attempt{};; ++attempt) {
+    // Looked up again after each wait: the block device may have moved in the
+    // registry, changed, or been mounted by someone else. It cannot be gone:
+    // it owns this task.
+    auto* const blk_device{registry_->block_devices.Find(object_path)};
+    if (blk_device == nullptr ||
+        (attempt > 0 &&
+         !mount::ShouldAutomount(*blk_device,
+                                 Decide(blk_device->Properties())))) {
+      co_return;
+    }
+
+    const auto result{co_await mount::Automount(
+        *blk_device, registry_->drives.Find(blk_device->Properties().drive),
+        context_)};
+    if (result) {
+      registry_->mount_points.InsertOrAssign(object_path, *result);
+
+      co_return;
+    }
+    if (result.error() == mount::MountError::kPermanent ||
+        context_.loop == nullptr) {
+      co_return;
+    }
+    if (attempt >= kMountBackoff.max_attempts) {
+      logging::Error({.object_path = object_path},
+                     "Giving up automounting {}", object_path.c_str());
+
+      co_return;
+    }
+
+    const auto delay{retry::Delay(kMountBackoff, attempt)};
+    logging::Debug(
+        {.object_path = object_path}, "Retrying to automount {} in {} ms",
+        object_path.c_str(),
+        std::chrono::duration_cast<std::chrono::milliseconds>(delay).count());
+    co_await coro::Sleep{*context_.loop, delay};
+  }
+}
 
 }  // namespace managers
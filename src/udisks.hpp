@@ -24,15 +24,27 @@
 #ifndef UDISKEN_UDISKS_HPP_
 #define UDISKEN_UDISKS_HPP_
 
-#include "options.hpp"
+#include "coro.hpp"
+#include "loop.hpp"
+#include "mount.hpp"
 
 #include <sdbus-c++/IConnection.h>
+#include <sdbus-c++/Message.h>
 #include <sdbus-c++/ProxyInterfaces.h>
 #include <sdbus-c++/Types.h>
 #include <udisks-sdbus-cpp/udisks_proxy_wrappers.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <deque>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace udisks {
@@ -47,6 +59,100 @@ static const sdbus::ObjectPath kEmptyObjectPath{"/"};
 
 namespace objects {
 
+/// Properties of one interface, as sent by UDisks in InterfacesAdded and
+/// PropertiesChanged signals.
+using PropertyMap = std::map<sdbus::PropertyName, sdbus::Variant>;
+/// Interfaces of an object with their properties, as sent by UDisks in
+/// InterfacesAdded signals.
+using InterfaceMap = std::map<sdbus::InterfaceName, PropertyMap>;
+/// Properties of one interface, as read from a PropertiesChanged signal into
+/// the arena of the event handling it. Only the nodes of the map are on the
+/// arena: names longer than the small string buffer are on the heap, and the
+/// values own a message allocated by sd-bus.
+using ChangedProperties = std::pmr::map<sdbus::PropertyName, sdbus::Variant>;
+
+/// Views a null-terminated byte array (D-Bus type: ay), such as a path sent by
+/// UDisks, as a string, without its terminator nor copying it.
+///
+/// @param bytes The byte array; must outlive the view.
+std::string_view ViewByteString(const std::vector<std::uint8_t>& bytes);
+
+/// Cached copy of the UDisks properties read when deciding whether, and how, to
+/// automount a block device.
+///
+/// Built from the InterfacesAdded signal payload and kept up to date with
+/// PropertiesChanged signals, so that reading a property never costs a D-Bus
+/// round trip.
+struct BlockProperties {
+  // org.freedesktop.UDisks2.Block
+  sdbus::ObjectPath drive{udisks::kEmptyObjectPath};
+  bool hint_auto{};
+  bool hint_ignore{};
+  bool hint_system{};
+  bool read_only{};
+  std::string hint_name{};
+  std::string hint_icon_name{};
+  std::string id_label{};
+  std::string id_uuid{};
+  /// Type of the filesystem or other content, such as "vfat".
+  std::string id_type{};
+  /// What the block device contains, such as "filesystem"; empty while there is
+  /// no media.
+  std::string id_usage{};
+
+  // org.freedesktop.UDisks2.Filesystem
+  /// Mount points, as raw null-terminated byte arrays (D-Bus type: aay).
+  std::vector<std::vector<std::uint8_t>> mount_points{};
+
+  // org.freedesktop.UDisks2.Loop
+  /// The block device is a loop device.
+  bool loop{};
+  /// File backing the loop device, as a raw null-terminated byte array (D-Bus
+  /// type: ay).
+  std::vector<std::uint8_t> loop_backing_file{};
+
+  /// Update the cached properties belonging to an interface.
+  ///
+  /// Properties of interfaces not cached here are ignored.
+  ///
+  /// @tparam Changed PropertyMap, or ChangedProperties.
+  ///
+  /// @param interface Interface the properties belong to.
+  /// @param changed Properties with their new value.
+  /// @param invalidated Properties whose value changed, but was not sent.
+  ///
+  /// @return A property that automounting depends on changed value.
+  template <class Changed>
+  bool Update(const sdbus::InterfaceName& interface, const Changed& changed,
+              std::span<const sdbus::PropertyName> invalidated = {});
+};
+
+/// Cached copy of the UDisks properties of a drive.
+struct DriveProperties {
+  // org.freedesktop.UDisks2.Drive
+  std::string model{};
+  std::string vendor{};
+  std::string serial{};
+  bool removable{};
+  bool ejectable{};
+  /// Bus the drive is connected to, such as "usb" or "sdio"; empty if
+  /// unknown.
+  std::string connection_bus{};
+  /// Rotation rate in RPM; 0 for non-rotating media, such as flash, and -1
+  /// for rotating media of unknown rate.
+  std::int32_t rotation_rate{};
+  /// Media is inserted; always true for drives without removable media.
+  bool media_available{};
+
+  /// Update the cached properties belonging to an interface; see
+  /// BlockProperties::Update.
+  ///
+  /// @return Media availability changed.
+  template <class Changed>
+  bool Update(const sdbus::InterfaceName& interface, const Changed& changed,
+              std::span<const sdbus::PropertyName> invalidated = {});
+};
+
 /// Drive object, which is the physical device behind its block device
 /// objects.
 class Drive {
@@ -69,6 +175,33 @@ class Drive {
   std::unique_ptr<udisks_sd::proxy_wrappers::UdisksDrive> drive_;
 };
 
+/// Drive objects of one connection, shared by their block devices.
+///
+/// A drive is created on first use, and destroyed along with the last block
+/// device using it: a disk with several partitions gets one Drive proxy, not
+/// one per partition.
+class DriveCache {
+ public:
+  /// @param connection Connection of the Drive proxies; must outlive the
+  /// cache and the drives it created.
+  explicit DriveCache(sdbus::IConnection& connection)
+      : connection_{&connection} {}
+
+  /// Get the drive object at a path, creating it if no block device uses it
+  /// yet.
+  std::shared_ptr<Drive> Get(const sdbus::ObjectPath& object_path);
+
+  /// Forget a drive removed from UDisks. Block devices still using it keep
+  /// it until they are removed too.
+  void Forget(const sdbus::ObjectPath& object_path) {
+    drives_.erase(object_path);
+  }
+
+ private:
+  sdbus::IConnection* connection_;
+  std::map<sdbus::ObjectPath, std::weak_ptr<Drive>> drives_{};
+};
+
 /// Block device object, upon which most UDISKEN actions take effect.
 class BlockDevice {
  public:
@@ -78,11 +211,13 @@ class BlockDevice {
   /// The block interface is required to construct this device.
   /// All other interfaces are optional, and can take nullptr.
   ///
-  /// The drive object will be made available automatically if it exists.
+  /// The drive object is only created when first accessed, through the drive
+  /// cache; see GetDrive.
   ///
   /// Unique_ptrs passed to this constructor will be moved to!
   BlockDevice(
       std::unique_ptr<udisks_sd::proxy_wrappers::UdisksBlock> block,
+      BlockProperties properties, DriveCache* drive_cache,
       std::unique_ptr<udisks_sd::proxy_wrappers::UdisksFilesystem>
           filesystem = nullptr,
       std::unique_ptr<udisks_sd::proxy_wrappers::UdisksLoop> loop =
@@ -92,6 +227,37 @@ class BlockDevice {
 
   const sdbus::ObjectPath& ObjectPath() const;
 
+  /// Get the cached properties of this block device.
+  const BlockProperties& Properties() const { return properties_; }
+  /// Update the cached properties of this block device; see
+  /// BlockProperties::Update.
+  template <class Changed>
+  bool UpdateProperties(const sdbus::InterfaceName& interface,
+                        const Changed& changed,
+                        std::span<const sdbus::PropertyName> invalidated) {
+    return properties_.Update(interface, changed, invalidated);
+  }
+
+  /// Merge interfaces newly implemented by the block device object, creating
+  /// their proxies and caching their properties.
+  ///
+  /// UDisks may announce interfaces of the same object over several
+  /// InterfacesAdded signals, e.g. Filesystem once probing is done.
+  ///
+  /// @param interfaces Interfaces and their properties, as sent by UDisks.
+  /// Interfaces already known only have their properties updated.
+  ///
+  /// @return The filesystem interface was added, or a property that
+  /// automounting depends on changed value.
+  bool AddInterfaces(const InterfaceMap& interfaces);
+
+  /// Forget an interface the block device object no longer implements,
+  /// destroying its proxy and cached properties.
+  ///
+  /// The block interface cannot be removed: forget the whole block device
+  /// instead.
+  void RemoveInterface(const sdbus::InterfaceName& interface);
+
   /// Get the block interface proxy; this proxy always exists as long as
   /// the block device is valid.
   ///
@@ -100,6 +266,13 @@ class BlockDevice {
     return *block_;
   }
 
+  /// Get the drive object behind this block device, creating its proxy on
+  /// first access.
+  ///
+  /// @return Pointer to the drive object; nullptr if the block device has no
+  /// drive, such as a loop device, or no drive cache was given.
+  Drive* GetDrive();
+
   /// Get the filesystem interface proxy.
   ///
   /// @throws logic_error Tried to access an interface that is not implemented
@@ -107,7 +280,7 @@ class BlockDevice {
   ///
   /// @return Reference to the filesystem interface proxy, not the pointer.
   auto Filesystem() -> udisks_sd::proxy_wrappers::UdisksFilesystem&;
-  bool HasFilesystem() { return filesystem_ != nullptr; }
+  bool HasFilesystem() const { return filesystem_ != nullptr; }
 
   /// Get the loop device interface proxy.
   ///
@@ -116,7 +289,7 @@ class BlockDevice {
   ///
   /// @return Reference to the loop device interface proxy, not the pointer.
   auto Loop() -> udisks_sd::proxy_wrappers::UdisksLoop&;
-  bool HasLoop() { return loop_ != nullptr; }
+  bool HasLoop() const { return loop_ != nullptr; }
 
   /// Get the partition interface proxy.
   ///
@@ -125,12 +298,41 @@ class BlockDevice {
   ///
   /// @return Reference to the partition interface proxy, not the pointer.
   auto Partition() -> udisks_sd::proxy_wrappers::UdisksPartition&;
-  bool HasPartition() { return partition_ != nullptr; }
+  bool HasPartition() const { return partition_ != nullptr; }
+
+  /// Whether automounting this block device's filesystem is in progress,
+  /// including waiting to retry.
+  bool MountPending() const { return automount_.Running(); }
+  /// Note a reason for not automounting this block device. The checks run
+  /// again on every retry, throttled start and media change: each reason is
+  /// only counted once per block device.
+  ///
+  /// @param reason Static string, such as "already mounted".
+  ///
+  /// @return The reason was not noted yet, and should be counted.
+  bool NoteSkip(std::string_view reason) {
+    if (std::ranges::contains(skips_, reason)) {
+      return false;
+    }
+    skips_.push_back(reason);
+
+    return true;
+  }
+
+  /// Start automounting this block device, owning the task: it is cancelled
+  /// when the filesystem or the block device is removed.
+  void StartAutomount(coro::Task<> task) {
+    automount_ = std::move(task);
+    automount_.Start();
+  }
 
  private:
-  /// Corresponding drive object for this block device. If it exists, it is
-  /// automatically created.
-  std::unique_ptr<Drive> drive_ = nullptr;
+  /// Cache providing the drive object; may be nullptr.
+  DriveCache* drive_cache_;
+  /// Corresponding drive object for this block device, once accessed.
+  std::shared_ptr<Drive> drive_ = nullptr;
+  /// Properties of this block device, read when automounting.
+  BlockProperties properties_;
   /// Proxy to the block interface of this block device object.
   std::unique_ptr<udisks_sd::proxy_wrappers::UdisksBlock> block_;
   /// Proxy to the filesystem present on the block device.
@@ -142,10 +344,19 @@ class BlockDevice {
   /// Proxy to the partition on the block device.
   std::unique_ptr<udisks_sd::proxy_wrappers::UdisksPartition>
       partition_ = nullptr;
+  /// Reasons for not automounting it noted so far.
+  std::vector<std::string_view> skips_{};
+  /// Automounting in progress, if any. Declared last, so that it is cancelled
+  /// before the proxies it uses are destroyed.
+  coro::Task<> automount_{};
 };
 
 }  // namespace objects
 
+namespace registry {
+struct DeviceRegistry;
+}  // namespace registry
+
 /// Entrypoints of most of UDISKEN's logic.
 namespace managers {
 
@@ -170,9 +381,31 @@ class UdisksManager final
   static constexpr auto kObjectPath{"/org/freedesktop/UDisks2/Manager"};
 };
 
-using InterfacesAndProperties =
-    const std::map<sdbus::InterfaceName,
-                   std::map<sdbus::PropertyName, sdbus::Variant>>&;
+using InterfacesAndProperties = const objects::InterfaceMap&;
+
+/// Checks if an object implements an UDisks interface.
+///
+/// @tparam UdisksInterface Proxy wrapper of the interface, such as
+/// udisks_sd::proxy_wrappers::UdisksBlock.
+///
+/// @param inp Interfaces of the object, with their properties.
+template <class UdisksInterface>
+bool HasInterface(InterfacesAndProperties& inp) {
+  // Built once: interface names are too long for the small string
+  // optimization, and this runs for every signal.
+  static const sdbus::InterfaceName kName{UdisksInterface::INTERFACE_NAME};
+
+  return inp.contains(kName);
+}
+
+/// Checks if an UDisks interface is in a list of interfaces, such as those
+/// removed from an object.
+template <class UdisksInterface>
+bool HasInterface(const std::vector<sdbus::InterfaceName>& interfaces) {
+  static const sdbus::InterfaceName kName{UdisksInterface::INTERFACE_NAME};
+
+  return std::ranges::contains(interfaces, kName);
+}
 
 /// Class handling UDisks objects and implemented interfaces.
 /// Almost all UDISKEN actions are executed in this class' virtual functions.
@@ -182,15 +415,17 @@ class UdisksObjectManager final
   /// Connect to UDisks using a system bus connection.
   ///
   /// @param connection System bus connection.
+  /// @param context Services and configuration used when automounting. Must
+  /// outlive the manager.
   explicit UdisksObjectManager(sdbus::IConnection& connection,
-                               options::Options options);
+                               mount::Context context);
 
   UdisksObjectManager(const UdisksObjectManager&) = delete;
   UdisksObjectManager(UdisksObjectManager&&) = delete;
   UdisksObjectManager& operator=(const UdisksObjectManager&) = delete;
   UdisksObjectManager& operator=(UdisksObjectManager&&) = delete;
 
-  ~UdisksObjectManager() noexcept { unregisterProxy(); }
+  ~UdisksObjectManager() noexcept;
 
  private:
   /// Processes interfaces and the objects implementing them, and runs vital
@@ -203,7 +438,74 @@ class UdisksObjectManager final
       const sdbus::ObjectPath& object_path,
       const std::vector<sdbus::InterfaceName>& interfaces) final;
 
-  options::Options options_;
+  /// Updates the cached properties of a known block device or drive, and
+  /// automounts when media was inserted.
+  void OnPropertiesChanged(sdbus::Message msg);
+
+  /// Start tracking a block device which was not rejected, creating its
+  /// proxies, and try to automount it.
+  ///
+  /// @param interfaces Interfaces the block device object implements, with
+  /// their properties, if any.
+  void AddBlockDevice(const sdbus::ObjectPath& object_path,
+                      objects::BlockProperties properties,
+                      const objects::InterfaceMap& interfaces);
+
+  /// Track a rejected block device as any other, if it is no longer rejected.
+  void Reconsider(const sdbus::ObjectPath& object_path);
+
+  /// Decision of the automount policy for a block device, with the cached
+  /// properties of its drive.
+  policy::Decision Decide(const objects::BlockProperties& blk) const;
+
+  /// Try to automount a known block device, unless it is already being
+  /// mounted. Deferred to the end of the initial scan while scanning.
+  ///
+  /// Block devices on removable drives are mounted right away; others, such
+  /// as loop devices, are throttled.
+  ///
+  /// @return Mounting started.
+  bool Automount(const sdbus::ObjectPath& object_path,
+                 objects::BlockDevice& blk_device);
+
+  /// Queue a block device to be automounted once the throttle allows it.
+  void Throttle(const sdbus::ObjectPath& object_path);
+
+  /// Start automounting the next throttled block device still worth it, then
+  /// wait before starting another one.
+  void StartThrottled();
+
+  /// Start automounting every block device found by the initial scan, drive
+  /// by drive. The filesystems of a drive are all mounted concurrently, once
+  /// the properties of the drive are known.
+  void AutomountScanned();
+
+  /// Keep the block devices of each drive listed after a block device's
+  /// Drive property may have changed.
+  void UpdateDriveOf(const sdbus::ObjectPath& object_path,
+                     const sdbus::ObjectPath& old_drive,
+                     const sdbus::ObjectPath& new_drive);
+
+  /// Automount a block device, recording the mount point, and retrying later
+  /// if the device was not ready.
+  auto AutomountTask(sdbus::ObjectPath object_path) -> coro::Task<>;
+
+  mount::Context context_;
+  /// Drive objects, shared by block devices; declared before the registry so
+  /// that it outlives them.
+  objects::DriveCache drive_cache_;
+  /// Objects seen so far, with their cached properties.
+  std::unique_ptr<registry::DeviceRegistry> registry_;
+  /// Scanning the objects UDisks already manages; automounting waits for the
+  /// scan to complete.
+  bool scanning_{true};
+  /// Block devices waiting for the throttle to be automounted, in order.
+  std::deque<sdbus::ObjectPath> throttled_{};
+  /// Timer ending the wait between two throttled mounts; set while waiting.
+  std::optional<loop::SourceId> throttle_timer_{};
+  /// Match rules for PropertiesChanged signals emitted by UDisks block devices
+  /// and drives, on the interfaces whose properties are cached.
+  std::vector<sdbus::Slot> properties_changed_slots_;
 };
 
 }  // namespace managers
@@ -0,0 +1,91 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Checks of the mount option profiles chosen for typical drives.
+
+#include "profiles.hpp"
+#include "udisks.hpp"
+
+#include <sdbus-c++/Types.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+/// Options of the profile chosen for a filesystem on a drive; empty for the
+/// defaults of UDisks.
+std::string OptionsFor(std::string_view fs_type,
+                       const objects::DriveProperties* drive) {
+  objects::BlockProperties blk{};
+  blk.id_type = fs_type;
+  const auto& options{profiles::Select(blk, drive)};
+  const auto it{options.find("options")};
+
+  return it == options.end() ? std::string{} : it->second.get<std::string>();
+}
+
+objects::DriveProperties Drive(std::string_view bus,
+                               std::int32_t rotation_rate) {
+  objects::DriveProperties drive{};
+  drive.connection_bus = bus;
+  drive.rotation_rate = rotation_rate;
+
+  return drive;
+}
+
+/// Number of failed checks.
+int failures{0};
+
+void Check(std::string_view what, const std::string& actual,
+           std::string_view expected) {
+  if (actual != expected) {
+    std::cerr << what << ": got \"" << actual << "\", expected \"" << expected
+              << "\"\n";
+    ++failures;
+  }
+}
+
+}  // namespace
+
+int main() {
+  const auto usb_stick{Drive("usb", -1)};
+  Check("USB stick of unknown rotation rate", OptionsFor("vfat", &usb_stick),
+        "noatime,lazytime");
+  const auto sd_card{Drive("sdio", -1)};
+  Check("SD card of unknown rotation rate", OptionsFor("exfat", &sd_card),
+        "noatime,lazytime");
+  const auto sd_reader{Drive("sdio", 5400)};
+  Check("FAT on a card reader reporting a rotation rate",
+        OptionsFor("vfat", &sd_reader), "noatime,lazytime");
+  const auto ssd{Drive("", 0)};
+  Check("SSD", OptionsFor("ext4", &ssd), "noatime,lazytime");
+  const auto hdd{Drive("", 7200)};
+  Check("Hard disk", OptionsFor("ext4", &hdd), "lazytime");
+  const auto sata_unknown{Drive("", -1)};
+  Check("Hard disk of unknown rotation rate",
+        OptionsFor("ext4", &sata_unknown), "lazytime");
+  Check("Loop device", OptionsFor("ext4", nullptr), "");
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
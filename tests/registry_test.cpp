@@ -0,0 +1,123 @@
+// UDISKEN: A small Linux automounter.
+//
+// SPDX-FileCopyrightText: 2026 Sofian-Hedi Krazini <sofian-hedi.krazini@proton.me>
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+// Copyright (C) 2026 Sofian-Hedi Krazini
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+// details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Checks of the flat map holding the known UDisks objects.
+
+#include "coro.hpp"
+#include "registry.hpp"
+
+#include <sdbus-c++/Types.h>
+
+#include <coroutine>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+
+namespace {
+
+/// Number of failed checks.
+int failures{0};
+
+void Check(std::string_view what, bool ok) {
+  if (!ok) {
+    std::cerr << what << ": failed\n";
+    ++failures;
+  }
+}
+
+/// Proxies not destroyed yet.
+std::set<const void*> live_proxies{};
+
+/// Stands for a D-Bus proxy, tracking whether it is alive.
+struct Proxy {
+  Proxy() { live_proxies.insert(this); }
+  Proxy(const Proxy&) = delete;
+  Proxy& operator=(const Proxy&) = delete;
+  ~Proxy() noexcept { live_proxies.erase(this); }
+};
+
+/// Awaitable never resuming, which uses its proxy when cancelled, like
+/// coro::MethodCall does.
+class UseProxy {
+ public:
+  explicit UseProxy(const Proxy& proxy) : proxy_{&proxy} {}
+  UseProxy(const UseProxy&) = delete;
+  UseProxy& operator=(const UseProxy&) = delete;
+
+  ~UseProxy() noexcept {
+    Check("Proxy alive when its call is cancelled",
+          live_proxies.contains(proxy_));
+  }
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> /*handle*/) const noexcept {}
+  void await_resume() const noexcept {}
+
+ private:
+  const Proxy* proxy_;
+};
+
+auto WaitOn(const Proxy& proxy) -> coro::Task<> { co_await UseProxy{proxy}; }
+
+/// Laid out like objects::BlockDevice: its task is declared after the proxy
+/// it uses.
+struct Device {
+  std::unique_ptr<Proxy> proxy{std::make_unique<Proxy>()};
+  coro::Task<> task{};
+
+  /// Start a task suspended on the proxy.
+  void Start() {
+    task = WaitOn(*proxy);
+    task.Start();
+  }
+};
+
+sdbus::ObjectPath Path(std::string_view name) {
+  return sdbus::ObjectPath{"/org/freedesktop/UDisks2/block_devices/" +
+                           std::string{name}};
+}
+
+}  // namespace
+
+int main() {
+  registry::FlatMap<Device> devices{};
+  for (const auto* name : {"sda", "sdb", "sdc"}) {
+    devices.InsertOrAssign(Path(name), Device{}).Start();
+  }
+
+  // Erasing a middle entry moves the last one into its place.
+  Check("Erase a suspended device", devices.Erase(Path("sdb")));
+  Check("Erased device is gone", !devices.Contains(Path("sdb")));
+  for (const auto* name : {"sda", "sdc"}) {
+    const auto* const device{devices.Find(Path(name))};
+    Check("Other devices are kept",
+          device != nullptr && device->task.Running() &&
+              live_proxies.contains(device->proxy.get()));
+  }
+
+  devices.InsertOrAssign(Path("sda"), Device{});
+  Check("Replaced device has no task",
+        !devices.Find(Path("sda"))->task.Running());
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}